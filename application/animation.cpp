@@ -0,0 +1,79 @@
+#include "animation.hpp"
+
+#include <algorithm>
+
+namespace animation {
+
+    Engine::Engine(std::size_t width, std::size_t height, uint32_t fps)
+        : width_(width), height_(height), fps_(fps ? fps : DefaultFps),
+          from_(width * height), to_(width * height), out_(width * height) {
+    }
+
+    void Engine::start(const Frame& target, Transition transition, uint32_t durationMs) {
+        /* Transition starts from whatever is shown now, even mid-transition*/
+        from_ = out_;
+        std::copy_n(target.begin(), std::min(target.size(), to_.size()), to_.begin());
+        transition_ = transition;
+        step_ = 0;
+        steps_ = (transition == Transition::CUT) ? 1 : std::max<uint32_t>(1, durationMs * fps_ / 1000);
+    }
+
+    const Frame& Engine::advance(uint32_t ticks) {
+        if (!isActive()) {
+            return out_;
+        }
+
+        step_ = std::min(step_ + std::max<uint32_t>(ticks, 1), steps_);
+        const uint16_t Alpha = static_cast<uint16_t>((step_ * 256) / steps_);
+
+        switch (transition_) {
+            case Transition::CROSSFADE:
+                crossfade(Alpha);
+                break;
+            case Transition::WIPE:
+                wipe(Alpha);
+                break;
+            case Transition::FADE_THROUGH_BLACK:
+                fadeThroughBlack(Alpha);
+                break;
+            case Transition::CUT:
+            default:
+                out_ = to_;
+                break;
+        }
+
+        return out_;
+    }
+
+    void Engine::crossfade(uint16_t alpha) {
+        color::lerp(from_.data(), to_.data(), out_.data(), out_.size(), alpha);
+    }
+
+    void Engine::wipe(uint16_t alpha) {
+        /* Edge position in Q8 columns, the edge column itself is blended*/
+        const uint32_t Edge = alpha * width_;
+        const std::size_t EdgeColumn = Edge >> 8;
+        const uint16_t EdgeAlpha = Edge & 0xFF;
+
+        for (std::size_t y = 0; y < height_; y++) {
+            const std::size_t Row = y * width_;
+            const std::size_t RowEdge = Row + std::min(EdgeColumn, width_);
+            const std::size_t RowEnd = Row + width_;
+
+            std::copy(to_.begin() + Row, to_.begin() + RowEdge, out_.begin() + Row);
+            if (RowEdge < RowEnd) {
+                color::lerp(&from_[RowEdge], &to_[RowEdge], &out_[RowEdge], 1, EdgeAlpha);
+                std::copy(from_.begin() + RowEdge + 1, from_.begin() + RowEnd, out_.begin() + RowEdge + 1);
+            }
+        }
+    }
+
+    void Engine::fadeThroughBlack(uint16_t alpha) {
+        const bool FadingOut = alpha < 128;
+        const uint16_t Level = FadingOut ? 256 - alpha * 2 : alpha * 2 - 256;
+        const Frame& Source = FadingOut ? from_ : to_;
+
+        std::copy(Source.begin(), Source.end(), out_.begin());
+        color::scale(out_.data(), out_.size(), Level);
+    }
+}
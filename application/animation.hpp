@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "color.hpp"
+
+namespace animation {
+
+    /**
+     * @brief Full display image, row-major, width * height pixels
+     */
+    using Frame = std::vector<color::CRGB>;
+
+    enum class Transition {
+        CUT,                ///< Switch instantly
+        CROSSFADE,          ///< Blend old frame into new one
+        WIPE,               ///< New frame slides in from the left with soft edge
+        FADE_THROUGH_BLACK, ///< Fade old frame out, then new frame in
+    };
+
+    /**
+     * @brief Fixed-timestep transition engine
+     * @details Transition progress is advanced by a fixed step per render tick and blended with
+     * Q8 fixed-point weights (0..256), no floating point on the render path.
+     * Ticks are driven by render::Scheduler at the same frame rate
+     */
+    class Engine {
+    public:
+        Engine(std::size_t width, std::size_t height, uint32_t fps = DefaultFps);
+
+        /**
+         * @brief Begin transition from the currently shown frame to target
+         * @param durationMs Transition length, rounded to whole ticks
+         */
+        void start(const Frame& target, Transition transition, uint32_t durationMs);
+
+        bool isActive(void) const {
+            return step_ < steps_;
+        }
+
+        /**
+         * @brief Advance transition and render output frame
+         * @param ticks Ticks passed since the previous call, dropped frames are skipped over
+         * @return const Frame& Frame to show at this tick
+         */
+        const Frame& advance(uint32_t ticks = 1);
+
+        uint32_t getFps(void) const {
+            return fps_;
+        }
+
+        static constexpr uint32_t DefaultFps = 60;
+
+    private:
+        void crossfade(uint16_t alpha);
+        void wipe(uint16_t alpha);
+        void fadeThroughBlack(uint16_t alpha);
+
+        std::size_t width_;
+        std::size_t height_;
+        uint32_t fps_;
+        Frame from_;
+        Frame to_;
+        Frame out_;
+        Transition transition_ = Transition::CUT;
+        uint32_t step_ = 0;
+        uint32_t steps_ = 0;
+    };
+}
@@ -1,37 +1,75 @@
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include "application.hpp"
+
 #include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include <cinttypes>
 
 #include "itf_display.hpp"
 #include "itf_board.hpp"
+#include "nettime.hpp"
+#include "word_clock.hpp"
+#include "animation.hpp"
+#include "render_scheduler.hpp"
 
-#define APPLICATION_TASK_STACK_SIZE     (3 * 1024)
+#define TIME_CHECK_PERIOD_US            (100 * 1000)
+#define MINUTE_TRANSITION               animation::Transition::CROSSFADE
+#define MINUTE_TRANSITION_MS            (800)
 
 static const char *TAG = "application";
 
-void ApplicationTask(void *arg);
+/**
+ * @brief Word clock face, cross-fades to the new phrase when the minute changes
+ */
+class ClockFace : public render::IRenderer {
+public:
+    explicit ClockFace(uint32_t fps) : animator_(wordclock::GridWidth, wordclock::GridHeight, fps) {}
 
-esp_err_t ApplicationInit(void) {
-    if (xTaskCreate(ApplicationTask, "applicationTask", APPLICATION_TASK_STACK_SIZE, NULL, 5, NULL) != pdPASS) {
-        ESP_LOGE(TAG, "application task creation failed (insufficient heap?)");
-        return ESP_FAIL;
-    }
+    bool render(const render::tick_t& tick, animation::Frame& frame) {
+        /* Wall clock is only looked at a few times per second, the face changes once per minute*/
+        if (tick.deadlineUs >= nextTimeCheckUs_) {
+            nextTimeCheckUs_ = tick.deadlineUs + TIME_CHECK_PERIOD_US;
 
-    ESP_LOGI(TAG, "inited");
-    return ESP_OK;
-}
+            if (NetTime::isInited() && NetTime::isTimeValid() && wordClock_.render(NetTime::getLocalTime(), face_)) {
+                /* First face after boot is shown at once, not faded in*/
+                animator_.start(face_, isShown_ ? MINUTE_TRANSITION : animation::Transition::CUT, MINUTE_TRANSITION_MS);
+                if (!isShown_) {
+                    isShown_ = true;
+                    ESP_LOGI(TAG, "first face at %" PRId64 " ms", tick.deadlineUs / 1000);
+                }
+            }
+        }
+
+        if (!animator_.isActive()) {
+            return false;
+        }
+
+        frame = animator_.advance(tick.elapsedTicks);
+        return true;
+    }
 
+private:
+    wordclock::Renderer wordClock_;
+    animation::Engine animator_;
+    animation::Frame face_;
+    int64_t nextTimeCheckUs_ = 0;
+    bool isShown_ = false;
+};
 
-void ApplicationTask(void *arg) {
+esp_err_t ApplicationInit(void) {
     /**
      *  At this point system components must be initialized
      */
-
     ILedMatrixDisplay *display = Board_getDisplay();
+    ESP_RETURN_ON_FALSE(display, ESP_FAIL, TAG, "no display");
 
-    
+    static ClockFace clockFace(CONFIG_RENDER_FPS);
+    static render::Scheduler scheduler(*display, wordclock::GridWidth, wordclock::GridHeight, CONFIG_RENDER_FPS);
 
-    while (1) {
-        vTaskDelay(portMAX_DELAY);
-    }
-}
\ No newline at end of file
+    ESP_RETURN_ON_ERROR(scheduler.addRenderer(clockFace), TAG, "failed to add clock face");
+    ESP_RETURN_ON_ERROR(scheduler.start(), TAG, "failed to start render scheduler");
+
+    ESP_LOGI(TAG, "inited");
+    return ESP_OK;
+}
@@ -0,0 +1,116 @@
+#include "render_scheduler.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+
+#include "esp_log.h"
+#include "esp_check.h"
+
+#define RENDER_TASK_STACK_SIZE      (4 * 1024)
+#define RENDER_TASK_PRIORITY        (6)
+
+static const char *TAG = "render";
+
+static metrics::Counter framesRendered("render.frames");
+static metrics::Counter ticksDropped("render.dropped");
+static metrics::Histogram frameTimeUs("render.frame_us");
+static metrics::Histogram jitterUs("render.jitter_us");
+
+namespace render {
+
+    Scheduler::Scheduler(ILedMatrixDisplay& display, std::size_t width, std::size_t height, uint32_t fps)
+        : display_(display), width_(width), height_(height),
+          fps_(fps ? fps : animation::Engine::DefaultFps), periodUs_(1'000'000 / fps_),
+          frame_(width * height) {
+    }
+
+    esp_err_t Scheduler::addRenderer(IRenderer& renderer) {
+        ESP_RETURN_ON_FALSE(task_ == nullptr, ESP_ERR_INVALID_STATE, TAG, "addRenderer: scheduler already started");
+        ESP_RETURN_ON_FALSE(renderersCount_ < renderers_.size(), ESP_ERR_NO_MEM, TAG, "addRenderer: too many renderers");
+
+        renderers_[renderersCount_++] = &renderer;
+        return ESP_OK;
+    }
+
+    esp_err_t Scheduler::start(void) {
+        ESP_RETURN_ON_FALSE(task_ == nullptr, ESP_ERR_INVALID_STATE, TAG, "start: already started");
+
+        if (xTaskCreate(&Scheduler::task, "renderTask", RENDER_TASK_STACK_SIZE, this, RENDER_TASK_PRIORITY, &task_) != pdPASS) {
+            ESP_LOGE(TAG, "start: render task creation failed (insufficient heap?)");
+            return ESP_FAIL;
+        }
+
+        const esp_timer_create_args_t TimerArgs = {
+            .callback = &Scheduler::onTick,
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "renderTick",
+            .skip_unhandled_events = false,
+        };
+        ESP_RETURN_ON_ERROR(esp_timer_create(&TimerArgs, &timer_), TAG, "start: tick timer creation failed");
+
+        startUs_ = esp_timer_get_time();
+        ESP_RETURN_ON_ERROR(esp_timer_start_periodic(timer_, periodUs_), TAG, "start: tick timer start failed");
+
+        ESP_LOGI(TAG, "start: %zu renderers @%" PRIu32 "fps", renderersCount_, fps_);
+        return ESP_OK;
+    }
+
+    void Scheduler::task(void* arg) {
+        static_cast<Scheduler*>(arg)->loop();
+    }
+
+    void Scheduler::onTick(void* arg) {
+        /* Notification value counts ticks the render task did not pick up yet*/
+        xTaskNotifyGive(static_cast<Scheduler*>(arg)->task_);
+    }
+
+    void Scheduler::loop(void) {
+        while (1) {
+            const uint32_t Ticks = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            if (Ticks == 0) {
+                continue;
+            }
+            renderFrame(Ticks);
+        }
+    }
+
+    void Scheduler::renderFrame(uint32_t ticks) {
+        TRACE_SCOPE("render.frame");
+        ticks_ += ticks;
+        const int64_t StartUs = esp_timer_get_time();
+        const int64_t DeadlineUs = startUs_ + static_cast<int64_t>(ticks_) * periodUs_;
+
+        const tick_t Tick = {
+            .frame = frameNumber_++,
+            .deadlineUs = DeadlineUs,
+            .elapsedTicks = ticks,
+        };
+
+        bool changed = false;
+        for (std::size_t i = 0; i < renderersCount_; i++) {
+            changed |= renderers_[i]->render(Tick, frame_);
+        }
+
+        if (changed) {
+            TRACE_SCOPE("render.draw");
+            for (std::size_t y = 0; y < height_; y++) {
+                for (std::size_t x = 0; x < width_; x++) {
+                    display_.drawPixel({x, y}, frame_[y * width_ + x]);
+                }
+            }
+        }
+        /* Presented every tick, display skips unchanged frames unless it has to refresh them*/
+        if (display_.present() != ESP_OK) {
+            ESP_LOGE(TAG, "renderFrame: failed to present frame %" PRIu32, Tick.frame);
+        }
+
+        const int64_t EndUs = esp_timer_get_time();
+        framesRendered.add();
+        ticksDropped.add(ticks - 1);
+        jitterUs.add(static_cast<uint32_t>(std::max<int64_t>(StartUs - DeadlineUs, 0)));
+        frameTimeUs.add(static_cast<uint32_t>(EndUs - StartUs));
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "itf_display.hpp"
+#include "animation.hpp"
+
+namespace render {
+
+    /**
+     * @brief Render tick handed over to renderers
+     */
+    typedef struct {
+        uint32_t frame;        ///< Sequence number of rendered frames
+        int64_t deadlineUs;    ///< Time the frame was due at
+        uint32_t elapsedTicks; ///< Ticks since the previous rendered frame, more than 1 if frames were dropped
+    } tick_t;
+
+    /**
+     * @brief Anything drawing into the display frame at scheduler rate
+     */
+    class IRenderer {
+    public:
+        virtual ~IRenderer() = default;
+
+        /**
+         * @brief Render frame for the tick
+         * @param tick Tick timing, animations should advance by tick.elapsedTicks
+         * @param frame Width * height frame, keeps content of the previous tick
+         * @return true if frame changed and must be drawn
+         */
+        virtual bool render(const tick_t& tick, animation::Frame& frame) = 0;
+    };
+
+    /**
+     * @brief Frame paced render loop
+     * @details A periodic esp_timer ticks at the target rate from absolute deadlines, the render
+     * task runs every registered renderer, draws the frame if any of them changed it and presents
+     * the display. A late frame makes the following ticks collapse into one, renderers see
+     * the skipped ticks in tick_t::elapsedTicks, so animations keep their speed.
+     * Frame time, start jitter and dropped ticks go to the metrics registry (render.*)
+     */
+    class Scheduler {
+    public:
+        static constexpr std::size_t MaxRenderers = 4;
+
+        Scheduler(ILedMatrixDisplay& display, std::size_t width, std::size_t height, uint32_t fps);
+
+        /**
+         * @brief Register renderer, renderers draw in registration order
+         * @note Must be called before start()
+         * @retval ESP_ERR_NO_MEM if MaxRenderers are already registered
+         */
+        esp_err_t addRenderer(IRenderer& renderer);
+
+        /**
+         * @brief Create render task and start ticking
+         */
+        esp_err_t start(void);
+
+        uint32_t getFps(void) const {
+            return fps_;
+        }
+
+    private:
+        static void task(void* arg);
+        static void onTick(void* arg);
+
+        void loop(void);
+        void renderFrame(uint32_t ticks);
+
+        ILedMatrixDisplay& display_;
+        std::size_t width_;
+        std::size_t height_;
+        uint32_t fps_;
+        int64_t periodUs_;
+        animation::Frame frame_;
+        std::array<IRenderer*, MaxRenderers> renderers_ {};
+        std::size_t renderersCount_ = 0;
+        TaskHandle_t task_ = nullptr;
+        esp_timer_handle_t timer_ = nullptr;
+        int64_t startUs_ = 0;        ///< Time the timer was started at, tick n is due at startUs_ + n * periodUs_
+        uint64_t ticks_ = 0;         ///< Ticks elapsed since start
+        uint32_t frameNumber_ = 0;
+    };
+}
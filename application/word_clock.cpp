@@ -0,0 +1,50 @@
+#include "word_clock.hpp"
+#include "word_clock_lang.hpp"
+#include "esp_log.h"
+
+static const char *TAG = "word_clock";
+
+namespace wordclock {
+
+    /* Tables come from the language pack selected by CONFIG_WORD_CLOCK_LANGUAGE*/
+    Mask compose(const tm& time) {
+        const std::size_t Slot = (time.tm_hour % 12) * 12 + time.tm_min / 5;
+
+        Mask mask;
+        for (const auto WordId : lang::Phrases[Slot]) {
+            if (WordId != lang::NoWord) {
+                mask |= lang::WordMasks[WordId];
+            }
+        }
+
+        const std::size_t Dots = time.tm_min % 5;
+        for (std::size_t dot = 0; dot < Dots && dot < lang::Dots.size(); dot++) {
+            mask |= lang::WordMasks[lang::Dots[dot]];
+        }
+
+        return mask;
+    }
+
+    bool Renderer::render(const tm& time, animation::Frame& frame) {
+        const Mask Composed = compose(time);
+        if (isDrawn_ && Composed == drawn_) {
+            return false;
+        }
+
+        expand(Composed, frame);
+
+        drawn_ = Composed;
+        isDrawn_ = true;
+        ESP_LOGI(TAG, "render: %02d:%02d", time.tm_hour, time.tm_min);
+        return true;
+    }
+
+    void Renderer::expand(const Mask& mask, animation::Frame& frame) const {
+        frame.resize(GridWidth * GridHeight);
+        for (std::size_t y = 0; y < GridHeight; y++) {
+            for (std::size_t x = 0; x < GridWidth; x++) {
+                frame[y * GridWidth + x] = mask.test(x, y) ? color_ : color::CRGB::Black;
+            }
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "time.h"
+#include "color.hpp"
+#include "animation.hpp"
+
+namespace wordclock {
+
+    constexpr std::size_t GridWidth = 16;
+    constexpr std::size_t GridHeight = 16;
+
+    /**
+     * @brief Set of lit letters on the 16x16 grid, one bit per cell
+     */
+    struct Mask {
+        static constexpr std::size_t BitsPerWord = 32;
+        std::array<uint32_t, GridWidth * GridHeight / BitsPerWord> words{};
+
+        /**
+         * @brief Mask of a horizontal word of len letters starting at (col, row)
+         */
+        static constexpr Mask span(std::size_t row, std::size_t col, std::size_t len) {
+            Mask mask;
+            for (std::size_t i = 0; i < len; i++) {
+                const std::size_t Bit = row * GridWidth + col + i;
+                mask.words[Bit / BitsPerWord] |= 1u << (Bit % BitsPerWord);
+            }
+            return mask;
+        }
+
+        constexpr Mask& operator|=(const Mask& other) {
+            for (std::size_t i = 0; i < words.size(); i++) {
+                words[i] |= other.words[i];
+            }
+            return *this;
+        }
+
+        constexpr bool test(std::size_t x, std::size_t y) const {
+            const std::size_t Bit = y * GridWidth + x;
+            return words[Bit / BitsPerWord] & (1u << (Bit % BitsPerWord));
+        }
+
+        constexpr bool operator==(const Mask& other) const {
+            return words == other.words;
+        }
+    };
+
+    /**
+     * @brief Builds the set of lit words for a given time
+     * @param time Local time, minutes are rounded down to 5 minute steps plus 0-4 extra minute dots
+     */
+    Mask compose(const tm& time);
+
+    class Renderer {
+    public:
+        explicit Renderer(const color::CRGB& color = color::CRGB::White) : color_(color) {}
+
+        /**
+         * @brief Render time into frame if the face changed since the last call
+         * @param frame GridWidth * GridHeight frame to fill
+         * @return true if frame was rendered, false if nothing changed
+         */
+        bool render(const tm& time, animation::Frame& frame);
+
+        /**
+         * @brief Expand mask into frame
+         */
+        void expand(const Mask& mask, animation::Frame& frame) const;
+
+        void setColor(const color::CRGB& color) {
+            color_ = color;
+            isDrawn_ = false;
+        }
+
+    private:
+        color::CRGB color_;
+        Mask drawn_ {};
+        bool isDrawn_ = false;
+    };
+}
@@ -0,0 +1,220 @@
+#include "led_bench.hpp"
+#include "addressable_led.hpp"
+#include "led_layout.hpp"
+#include "color.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_console.h"
+#endif
+
+static const char *TAG = "ledBench";
+
+#define BENCH_STRIP_TYPE        LedType::WS2812B
+#define BENCH_ENCODE_CHUNK      8   //< bytes per encoder call, 64 symbols of DEFAULT RMT memory block
+#define BENCH_GAMMA             2.2f
+
+#if CONFIG_IDF_TARGET_LINUX
+#define BENCH_GPIO              0   //< unused on host
+#elif defined(CONFIG_LED_BENCH_GPIO)
+#define BENCH_GPIO              CONFIG_LED_BENCH_GPIO
+#else
+#define BENCH_GPIO              22
+#endif
+
+#ifdef CONFIG_LED_BENCH_PIXEL_BUDGET
+#define BENCH_PIXEL_BUDGET      CONFIG_LED_BENCH_PIXEL_BUDGET
+#else
+#define BENCH_PIXEL_BUDGET      65536
+#endif
+
+namespace {
+    /* 16x16 panels tiled up to 4096 LEDs, same wiring as the clock matrix*/
+    using Panel = layout::Panel<16, 16, layout::Wiring::SERPENTINE>;
+    template<std::size_t TilesX, std::size_t TilesY>
+    using TiledMap = layout::Map<layout::Tiled<Panel, TilesX, TilesY>>;
+
+    /**
+     * @brief Keep compiler from dropping results of the measured code
+     */
+    inline void doNotOptimize(const void* ptr) {
+        asm volatile("" : : "r"(ptr) : "memory");
+    }
+
+    class Runner {
+    public:
+        Runner(const char* filter, size_t pixelBudget)
+            : filter_(filter), pixelBudget_(pixelBudget ? pixelBudget : 1) {}
+
+        /**
+         * @brief Time body(iteration) repeated over the pixel budget and print the result
+         */
+        template<typename Body>
+        void measure(const char* name, size_t leds, Body&& body) {
+            if (filter_ != nullptr && strstr(name, filter_) == nullptr) {
+                return;
+            }
+            const size_t Iterations = std::max<size_t>(1, pixelBudget_ / leds);
+
+            body(0); //< warm up caches
+            const int64_t StartUs = esp_timer_get_time();
+            for (size_t i = 0; i < Iterations; i++) {
+                body(i);
+            }
+            const int64_t TotalUs = esp_timer_get_time() - StartUs;
+
+            const double NsPerPixel = TotalUs * 1000.0 / (static_cast<double>(Iterations) * leds);
+            printf("{\"bench\":\"%s\",\"target\":\"%s\",\"leds\":%zu,\"iterations\":%zu,"
+                   "\"total_us\":%" PRId64 ",\"ns_per_pixel\":%.2f}\n",
+                   name, CONFIG_IDF_TARGET, leds, Iterations, TotalUs, NsPerPixel);
+            fflush(stdout);
+            cases_++;
+        }
+
+        size_t getCases(void) const {
+            return cases_;
+        }
+
+    private:
+        const char* filter_;
+        size_t pixelBudget_;
+        size_t cases_ = 0;
+    };
+
+    /**
+     * @retval ESP_ERR_* of the strip setup, e.g. no free RMT channel or the bench pin in use
+     */
+    template<typename Map>
+    esp_err_t runSize(Runner& runner) {
+        constexpr size_t Leds = Map::ledCount;
+
+        std::vector<color::CRGB> frame(Leds);
+        std::vector<color::CGRB> converted(Leds);
+        std::vector<color::CRGB> scaled(Leds);
+        for (size_t i = 0; i < Leds; i++) {
+            frame[i] = color::CRGB(i * 7, i * 13, i * 29);
+        }
+
+        runner.measure("map", Leds, [&](size_t) {
+            size_t sum = 0;
+            for (size_t y = 0; y < Map::height; y++) {
+                for (size_t x = 0; x < Map::width; x++) {
+                    sum += Map::index(x, y);
+                }
+            }
+            doNotOptimize(&sum);
+        });
+
+        runner.measure("convert", Leds, [&](size_t) {
+            color::convert(frame.data(), converted.data(), Leds);
+            doNotOptimize(converted.data());
+        });
+
+        runner.measure("scale", Leds, [&](size_t) {
+            /* Scaling in place would fade the input to black over the iterations*/
+            std::copy(frame.begin(), frame.end(), scaled.begin());
+            color::scale(scaled.data(), Leds, 200);
+            doNotOptimize(scaled.data());
+        });
+
+        /* Console command must not abort the device when the bench pin or RMT channels are taken*/
+        AddresableLED<BENCH_STRIP_TYPE> strip(Leds, static_cast<gpio_num_t>(BENCH_GPIO));
+        ESP_RETURN_ON_ERROR(strip.getInitError(), TAG, "run: unable to set up %zu LED strip on gpio %d",
+                            Leds, BENCH_GPIO);
+        strip.setGamma(BENCH_GAMMA);
+        strip.setDithering(true);
+
+        runner.measure("set_color", Leds, [&](size_t iteration) {
+            /* Color differs between iterations, so every call really writes*/
+            const color::CRGB Color(iteration, iteration >> 8, 0x40);
+            for (size_t i = 0; i < Leds; i++) {
+                strip.setColor(Color, i);
+            }
+        });
+
+        runner.measure("set_color_range", Leds, [&](size_t iteration) {
+            strip.setColor(color::CRGB(iteration, 0x80, 0x40), 0, Leds);
+        });
+
+        runner.measure("set_colors", Leds, [&](size_t) {
+            strip.setColors(frame.data(), 0, Leds);
+        });
+
+        /* Output table rebuild plus a full frame through gamma, brightness and dithering to the wire*/
+        runner.measure("brightness", Leds, [&](size_t iteration) {
+            strip.setBrightness(static_cast<uint8_t>(iteration));
+            strip.update();
+        });
+
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(converted.data());
+        const size_t Size = Leds * sizeof(color::CGRB);
+        uint32_t symbols[BENCH_ENCODE_CHUNK * addressable_led::SymbolsPerByte];
+        runner.measure("encode", Leds, [&](size_t) {
+            for (size_t position = 0; position < Size; position += BENCH_ENCODE_CHUNK) {
+                const size_t Count = std::min<size_t>(BENCH_ENCODE_CHUNK, Size - position);
+                strip.encodeSymbols(bytes + position, position, Count, symbols, 0);
+                doNotOptimize(symbols);
+            }
+        });
+        return ESP_OK;
+    }
+
+#if !CONFIG_IDF_TARGET_LINUX
+    int benchCommand(int argc, char** argv) {
+        const char* filter = (argc > 1) ? argv[1] : nullptr;
+        return (LedBench_run(filter, BENCH_PIXEL_BUDGET) == ESP_OK) ? 0 : 1;
+    }
+#endif
+}
+
+esp_err_t LedBench_run(const char *filter, size_t pixelBudget) {
+    ESP_LOGI(TAG, "run: filter '%s', pixel budget %zu", filter ? filter : "", pixelBudget);
+
+    Runner runner(filter, pixelBudget);
+    esp_err_t ret = runSize<TiledMap<1, 1>>(runner);
+    if (ret == ESP_OK) {
+        ret = runSize<TiledMap<2, 1>>(runner);
+    }
+    if (ret == ESP_OK) {
+        ret = runSize<TiledMap<2, 2>>(runner);
+    }
+    if (ret == ESP_OK) {
+        ret = runSize<TiledMap<4, 2>>(runner);
+    }
+    if (ret == ESP_OK) {
+        ret = runSize<TiledMap<4, 4>>(runner);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (runner.getCases() == 0) {
+        ESP_LOGE(TAG, "run: no case matches '%s'", filter);
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t LedBench_registerCommand(void) {
+#if CONFIG_IDF_TARGET_LINUX
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    const esp_console_cmd_t Command = {
+        .command = "bench",
+        .help = "Measure LED pipeline ns/pixel, optional argument selects cases by name: "
+                "map, convert, scale, set_color, set_color_range, set_colors, brightness, encode",
+        .hint = "[case]",
+        .func = &benchCommand,
+    };
+    return esp_console_cmd_register(&Command);
+#endif
+}
@@ -0,0 +1,28 @@
+/**
+ * @brief LED pipeline benchmark
+ *
+ * Measures ns/pixel of layout mapping, color operations and RMT symbol encoding
+ * for strip sizes from 256 to 4096 LEDs. Every measurement is printed to stdout
+ * as a single line JSON object, e.g.
+ * {"bench":"encode","target":"esp32","leds":256,"iterations":256,"total_us":4210,"ns_per_pixel":64.24}
+ */
+
+#pragma once
+
+#include <cstddef>
+#include "esp_err.h"
+
+/**
+ * @brief Run benchmark cases
+ * @param filter Run only cases which name contains filter, nullptr runs all of them
+ * @param pixelBudget Pixels processed per measurement, a case is repeated pixelBudget / leds times
+ * @return esp_err_t
+ * @retval ESP_ERR_NOT_FOUND if no case matches the filter
+ */
+esp_err_t LedBench_run(const char *filter, size_t pixelBudget);
+
+/**
+ * @brief Register "bench [case]" command in the console
+ * @note Console REPL must be created by the caller
+ */
+esp_err_t LedBench_registerCommand(void);
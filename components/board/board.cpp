@@ -1,7 +1,12 @@
 #include <string>
 #include "itf_board.hpp"
-#include "board_display.hpp"
 #include "esp_err.h"
+#include "sdkconfig.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include "board_display_sim.hpp"
+#else
+#include "board_display.hpp"
+#endif
 
 // Board identification
 std::string Board_getName(void) {
@@ -21,6 +26,10 @@ std::string Board_getSerialNumber(void) {
 }
 
 ILedMatrixDisplay *Board_getDisplay(void) {
+#if CONFIG_IDF_TARGET_LINUX
+    static SimDisplay display;
+#else
     static TextClockDisplay display;
+#endif
     return &display;
 }
\ No newline at end of file
@@ -1,14 +1,39 @@
 #include "board_display.hpp"
+#include "trace.hpp"
 #include "esp_log.h"
 #include "esp_check.h"
-
-#define DISPLAY_CONN_PIN  GPIO_NUM_23
+#include <iterator>
 
 static const char *TAG = "board_display";
 
+/**
+ * Data lines of the matrix, first pin drives the top band of rows.
+ * Rows are split evenly between pins, every band is transmitted in parallel,
+ * so frame time is divided by the number of pins.
+ */
+static const gpio_num_t DisplayConnPins[] = {GPIO_NUM_23};
+
+static_assert(DisplayLayout::height % std::size(DisplayConnPins) == 0,
+              "every data line must drive the same number of whole rows");
+
 esp_err_t TextClockDisplay::init(const ILedMatrixDisplay::resolution_t& resolution) {
-    ledStrip_ = new AddresableLED<LedType::WS2812B>(resolution.x * resolution.y, DISPLAY_CONN_PIN);
+    if (resolution.x != DisplayLayout::width || resolution.y != DisplayLayout::height) {
+        ESP_LOGE(TAG, "init: %dx%d resolution does not match %dx%d board layout",
+                 resolution.x, resolution.y, DisplayLayout::width, DisplayLayout::height);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    /* Bands of whole rows are consecutive in the chain, so segments split the strip on row borders*/
+    const std::vector<gpio_num_t> ConnPins(std::begin(DisplayConnPins), std::end(DisplayConnPins));
+    ledStrip_ = new DisplayStrip(DisplayLayout::ledCount, ConnPins);
     ESP_RETURN_ON_FALSE(ledStrip_, ESP_FAIL, TAG, "failed to create ledstrip");
+    ESP_RETURN_ON_ERROR(ledStrip_->getInitError(), TAG, "failed to set up ledstrip");
+
+    /* Keep low night mode brightness levels smooth and hue stable*/
+    ledStrip_->setGamma(DISPLAY_GAMMA);
+    ledStrip_->setDithering(true);
+    /* Next frame is rendered while the previous one is still on the wire*/
+    ledStrip_->setUpdateMode(UpdateMode::ASYNC);
     
     ESP_RETURN_ON_ERROR(ledStrip_->update(), TAG, "failed to update ledstrip buffer");
 
@@ -22,26 +47,33 @@ esp_err_t TextClockDisplay::init(const ILedMatrixDisplay::resolution_t& resoluti
 esp_err_t TextClockDisplay::drawPixel(const point_t& point, const color::CRGB& color) {
     ESP_RETURN_ON_FALSE(isInited_, ESP_FAIL, TAG, "drawPixel: not inited");
 
-    if (point.x > resolution_.x || point.y > resolution_.y) {
+    if (point.x >= resolution_.x || point.y >= resolution_.y) {
         ESP_LOGE(TAG, "drawPixel: x:%d,y:%d - no such point", point.x, point.y);
         return ESP_ERR_INVALID_ARG;
     }
 
-    const size_t LedsInRows = (point.y + 1) * resolution_.x;
-    const size_t LedsCount = (point.y % 2) ? LedsInRows - point.x - 1 : point.x;
+    const size_t LedIndex = DisplayLayout::index(point.x, point.y);
 
-    ESP_RETURN_ON_ERROR(ledStrip_->setColor(color, LedsCount), TAG, "drawPixel: failed to set");
-    ESP_RETURN_ON_ERROR(ledStrip_->update(), TAG, "drawPixel: failed to update led strip buffer");
+    ESP_RETURN_ON_ERROR(ledStrip_->setColor(color, LedIndex), TAG, "drawPixel: failed to set");
 
-    ESP_LOGI(TAG, "drawPixel: point{%d,%d} set up", point.x, point.y);
+    ESP_LOGD(TAG, "drawPixel: point{%d,%d} set up", point.x, point.y);
     return ESP_OK;
 }
 
 esp_err_t TextClockDisplay::clear(void) {
     ESP_RETURN_ON_FALSE(isInited_, ESP_FAIL, TAG, "clear: not inited");
+    TRACE_SCOPE("display.clear");
 
     ledStrip_->clear();
-    ESP_RETURN_ON_ERROR(ledStrip_->update(), TAG, "clear: failed to update led strip buffer");
+
+    return ESP_OK;
+}
+
+esp_err_t TextClockDisplay::present(void) {
+    ESP_RETURN_ON_FALSE(isInited_, ESP_FAIL, TAG, "present: not inited");
+    TRACE_SCOPE("display.present");
+
+    ESP_RETURN_ON_ERROR(ledStrip_->update(), TAG, "present: failed to update led strip buffer");
 
     return ESP_OK;
 }
@@ -56,6 +88,7 @@ ILedMatrixDisplay::resolution_t TextClockDisplay::getResolution(void) const {
 
 esp_err_t TextClockDisplay::setBrightness(const uint8_t level) {
     ESP_RETURN_ON_FALSE(isSupportBrightnessControl(), ESP_FAIL, TAG, "setBrightness: not supported");
+    TRACE_SCOPE("display.brightness");
 
     ledStrip_->setBrightness(level);
 
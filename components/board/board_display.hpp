@@ -1,7 +1,7 @@
 #pragma once
 
 #include "itf_display.hpp"
-#include "addressable_led.hpp"
+#include "board_display_config.hpp"
 #include "esp_err.h"
 
 class TextClockDisplay : public ILedMatrixDisplay {
@@ -17,6 +17,8 @@ public:
 
     esp_err_t clear(void);
 
+    esp_err_t present(void);
+
     bool isSupportBrightnessControl(void) const {
         return true;
     }
@@ -26,5 +28,5 @@ public:
 private:
     bool isInited_ = false;
     ILedMatrixDisplay::resolution_t resolution_ = {0, 0};
-    AddresableLED<LedType::WS2812B> *ledStrip_ = nullptr;
+    DisplayStrip *ledStrip_ = nullptr;
 };
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "addressable_led.hpp"
+#include "led_layout.hpp"
+
+/* Shared by the device display and the host simulator, so both run the same LED pipeline*/
+
+/* Wiring of the text clock matrix: single 16x16 panel, rows chained in zigzag*/
+using DisplayLayout = layout::Map<layout::Panel<16, 16, layout::Wiring::SERPENTINE>>;
+
+constexpr LedType DisplayLedType = LedType::WS2812B;
+using DisplayStrip = AddresableLED<DisplayLedType>;
+
+#define DISPLAY_GAMMA     (2.2f)
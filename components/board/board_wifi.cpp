@@ -2,62 +2,262 @@
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 
+#include <algorithm>
 #include <cstring> // for memcpy
 #include <inttypes.h>
 #include <string>
 
 #include "itf_wifi.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
 #include "esp_check.h"
 #include "esp_bit_defs.h"
 #include "esp_wifi.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "nvs.h"
 
 #define WIFI_CONNECTED_FLAG BIT0
-#define WIFI_FAILED_FLAG    BIT1
+#define WIFI_STOPPED_FLAG   BIT1
+
+#define WIFI_RETRY_MIN_MS   (250)           //< first retry after a failure, doubles with every failed attempt
+#define WIFI_RETRY_MAX_MS   (60 * 1000)
+#define WIFI_RETRY_POST_MS  (100)           //< event queue was full, post the retry again after this delay
+
+#define NVS_NAMESPACE       "board_wifi"
+#define NVS_KEY_AP          "ap"
+
+ESP_EVENT_DEFINE_BASE(BOARD_WIFI_EVENT);
+
+enum {
+    BOARD_WIFI_EVENT_RETRY,     ///< Backoff expired, posted by the retry timer
+    BOARD_WIFI_EVENT_STOP,      ///< User disconnect, posted by Board_wifiDisconnect
+};
+
+/**
+ * @brief Last AP joined, a direct join to it skips the scan
+ */
+typedef struct {
+    uint8_t ssid[32];
+    uint8_t bssid[6];
+    uint8_t channel;
+} ap_cache_t;
 
 typedef struct {
     esp_netif_t *netif;
     bool isUserRequest;
     bool isInited;
     void (*failCallBack)(WifiFailEvents event);
+    void (*stateCallBack)(WifiState state);
+    WifiState state;
+    wifi_config_t config;
+    esp_timer_handle_t retryTimer;
+    uint32_t failedAttempts;    ///< Since the last connection
+    bool tryDirectJoin;         ///< Next attempt joins the cached AP without scanning
+    bool isCacheValid;
+    ap_cache_t cache;
+    int64_t attemptStartUs;
+    esp_err_t stopResult;       ///< Outcome of the last user disconnect
 } wifi_context_t;
 
 static const char *TAG = "board_wifi";
 static wifi_context_t gContext;
 static EventGroupHandle_t gWifiEventGroup;
 
+static metrics::Histogram gConnectTimeMs("wifi.connect_ms");
+static metrics::Counter gConnectFailures("wifi.connect_fail");
+static metrics::Counter gDisconnectsUser("wifi.disc_user");
+static metrics::Counter gDisconnectsNoAp("wifi.disc_no_ap");
+static metrics::Counter gDisconnectsBeacon("wifi.disc_beacon");
+static metrics::Counter gDisconnectsOther("wifi.disc_other");
+static metrics::Gauge gLastDisconnectReason("wifi.last_reason");
+static metrics::Counter gReconnects("wifi.reconnects");
+static metrics::Counter gDirectJoins("wifi.direct_join");
+
+/* State machine runs in the default event loop task, only Board_wifiStart touches
+ * the context from the caller while the manager is stopped*/
+
+static void setState(WifiState state) {
+    if (gContext.state == state) {
+        return;
+    }
+    gContext.state = state;
+    ESP_LOGD(TAG, "state: %d", static_cast<int>(state));
+    if (gContext.stateCallBack) {
+        gContext.stateCallBack(state);
+    }
+}
+
+static void loadApCache(void) {
+    gContext.isCacheValid = false;
+
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    std::size_t size = sizeof(gContext.cache);
+    const bool Found = nvs_get_blob(nvs, NVS_KEY_AP, &gContext.cache, &size) == ESP_OK && size == sizeof(gContext.cache);
+    nvs_close(nvs);
+
+    /* Cache of another network is of no use*/
+    gContext.isCacheValid = Found &&
+        std::memcmp(gContext.cache.ssid, gContext.config.sta.ssid, sizeof(gContext.cache.ssid)) == 0;
+}
+
+static void saveApCache(const uint8_t *bssid, uint8_t channel) {
+    if (gContext.isCacheValid && gContext.cache.channel == channel &&
+        std::memcmp(gContext.cache.bssid, bssid, sizeof(gContext.cache.bssid)) == 0) {
+        return;
+    }
+
+    std::memcpy(gContext.cache.ssid, gContext.config.sta.ssid, sizeof(gContext.cache.ssid));
+    std::memcpy(gContext.cache.bssid, bssid, sizeof(gContext.cache.bssid));
+    gContext.cache.channel = channel;
+    gContext.isCacheValid = true;
+
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret == ESP_OK) {
+        ret = nvs_set_blob(nvs, NVS_KEY_AP, &gContext.cache, sizeof(gContext.cache));
+        if (ret == ESP_OK) {
+            ret = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "unable to store AP for direct join: %s", esp_err_to_name(ret));
+    }
+}
+
+/**
+ * @brief Join the cached AP directly on the first attempt after start or a lost connection, scan otherwise
+ */
+static void startAttempt(void) {
+    wifi_config_t config = gContext.config;
+    gContext.tryDirectJoin = gContext.tryDirectJoin && gContext.isCacheValid;
+    if (gContext.tryDirectJoin) {
+        config.sta.bssid_set = true;
+        std::memcpy(config.sta.bssid, gContext.cache.bssid, sizeof(config.sta.bssid));
+        config.sta.channel = gContext.cache.channel;
+        gDirectJoins.add();
+    }
+
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &config));
+    gContext.attemptStartUs = esp_timer_get_time();
+    setState(WifiState::CONNECTING);
+
+    const esp_err_t Ret = esp_wifi_connect();
+    if (Ret != ESP_OK) {
+        ESP_LOGW(TAG, "attempt: connect failed to start: %s", esp_err_to_name(Ret));
+    }
+}
+
+/**
+ * @brief Schedule the next attempt with exponential backoff and jitter
+ */
+static void scheduleRetry(void) {
+    const uint32_t Shift = std::min<uint32_t>(gContext.failedAttempts, 16);
+    const uint32_t BackoffMs = std::min<uint32_t>(WIFI_RETRY_MIN_MS << Shift, WIFI_RETRY_MAX_MS);
+    /* Random half of the backoff keeps devices behind one AP from retrying in lockstep*/
+    const uint32_t DelayMs = BackoffMs / 2 + esp_random() % (BackoffMs / 2 + 1);
+
+    gContext.failedAttempts++;
+    setState(WifiState::BACKOFF);
+    esp_timer_stop(gContext.retryTimer);
+    ESP_ERROR_CHECK(esp_timer_start_once(gContext.retryTimer, static_cast<uint64_t>(DelayMs) * 1000));
+    ESP_LOGI(TAG, "retry: attempt %" PRIu32 " in %" PRIu32 " ms", gContext.failedAttempts, DelayMs);
+}
+
+static void retryTimeout(void *arg) {
+    /* Attempts are started from the event loop task only*/
+    const esp_err_t Ret = esp_event_post(BOARD_WIFI_EVENT, BOARD_WIFI_EVENT_RETRY, nullptr, 0, 0);
+    if (Ret != ESP_OK) {
+        /* Lost retry would leave the manager in backoff for good*/
+        ESP_LOGW(TAG, "retry: unable to post event (%s), trying again", esp_err_to_name(Ret));
+        esp_timer_start_once(gContext.retryTimer, WIFI_RETRY_POST_MS * 1000);
+    }
+}
+
+/**
+ * @brief Stop the manager on user request, runs in the event loop task after any queued retry
+ */
+static void stopManager(void) {
+    gContext.isUserRequest = true;
+    esp_timer_stop(gContext.retryTimer);
+
+    gContext.stopResult = esp_wifi_disconnect();
+    if (gContext.stopResult == ESP_ERR_WIFI_NOT_INIT) {
+        ESP_LOGW(TAG, "disconnect: wifi not initialized when trying to disconnect");
+    } else if (gContext.stopResult != ESP_OK) {
+        ESP_LOGE(TAG, "disconnect: failed to disconnect wifi");
+    } else {
+        ESP_LOGI(TAG, "disconnect: wifi disconnection initiated");
+    }
+
+    ESP_ERROR_CHECK(esp_wifi_stop());
+    setState(WifiState::DISCONNECTED);
+    xEventGroupSetBits(gWifiEventGroup, WIFI_STOPPED_FLAG);
+}
+
 static void eventHandler(void *arg, esp_event_base_t eventBase, int32_t eventId, void *eventData) {
     if (eventBase == WIFI_EVENT) {
         switch (eventId) {
             case WIFI_EVENT_STA_START:
-                esp_wifi_connect();
+                startAttempt();
                 break;
 
             case WIFI_EVENT_STA_DISCONNECTED: {
                 wifi_event_sta_disconnected_t* disconEvent = static_cast<wifi_event_sta_disconnected_t*>(eventData);
                 std::string reasonStr;
+                TRACE_INSTANT("wifi.disconnected");
                 
-                /* Fail bit rise in case or NON user initiated disconnects*/
-                if (gContext.isUserRequest) {
+                /* Retry in case of NON user initiated disconnects*/
+                if (gContext.isUserRequest || gContext.state == WifiState::DISCONNECTED) {
                     reasonStr = "User initiated";
                     gContext.isUserRequest = false;
+                    gDisconnectsUser.add();
+                    setState(WifiState::DISCONNECTED);
                 } else {
                     switch (disconEvent->reason) {
                         case WIFI_REASON_NO_AP_FOUND:
                             reasonStr = "SSID not found";
-                            gContext.failCallBack(WifiFailEvents::FAIL_TO_CONNECT);
+                            gDisconnectsNoAp.add();
+                            if (gContext.failCallBack) {
+                                gContext.failCallBack(WifiFailEvents::FAIL_TO_CONNECT);
+                            }
                             break;
                         case WIFI_REASON_BEACON_TIMEOUT:
                             reasonStr = "Beacon timeout";
-                            gContext.failCallBack(WifiFailEvents::BEACON_TIMEOUT);
+                            gDisconnectsBeacon.add();
+                            if (gContext.failCallBack) {
+                                gContext.failCallBack(WifiFailEvents::BEACON_TIMEOUT);
+                            }
                             break;
                         default:
                             reasonStr = "Unknown reason";
-                            gContext.failCallBack(WifiFailEvents::FAIL_UNKNOWN);
+                            gDisconnectsOther.add();
+                            if (gContext.failCallBack) {
+                                gContext.failCallBack(WifiFailEvents::FAIL_UNKNOWN);
+                            }
                             break;
                     }
-                    xEventGroupSetBits(gWifiEventGroup, WIFI_FAILED_FLAG);
+
+                    if (gContext.state == WifiState::CONNECTED) {
+                        /* Lost connection, first retry joins the same AP directly*/
+                        gReconnects.add();
+                        gContext.failedAttempts = 0;
+                        gContext.tryDirectJoin = true;
+                    } else {
+                        gConnectFailures.add();
+                        if (gContext.tryDirectJoin) {
+                            ESP_LOGI(TAG, "wifi event handler: direct join failed, scanning next");
+                        }
+                        gContext.tryDirectJoin = false;
+                    }
+                    scheduleRetry();
                 }
 
+                gLastDisconnectReason.set(disconEvent->reason);
                 ESP_LOGW(TAG, "wifi event handler: disconnected from AP (reason: #%d - %s)", disconEvent->reason, reasonStr.c_str());
                 xEventGroupClearBits(gWifiEventGroup, WIFI_CONNECTED_FLAG);
                 break;
@@ -65,7 +265,9 @@ static void eventHandler(void *arg, esp_event_base_t eventBase, int32_t eventId,
 
             case WIFI_EVENT_STA_CONNECTED: {
                 wifi_event_sta_connected_t* connEvent = static_cast<wifi_event_sta_connected_t*>(eventData);
+                TRACE_INSTANT("wifi.connected");
                 ESP_LOGI(TAG, "wifi event handler: connected to AP: %s , channel: %d)", connEvent->ssid, connEvent->channel);
+                saveApCache(connEvent->bssid, connEvent->channel);
                 break;
             }
             
@@ -76,14 +278,34 @@ static void eventHandler(void *arg, esp_event_base_t eventBase, int32_t eventId,
         switch (eventId) {
             case IP_EVENT_STA_GOT_IP: {
                 ip_event_got_ip_t* gotIpEvent = static_cast<ip_event_got_ip_t*>(eventData);
+                TRACE_INSTANT("wifi.got_ip");
                 ESP_LOGI(TAG, "wifi event handler: got IP: " IPSTR ", gateway: " IPSTR ", netmask: " IPSTR,
                        IP2STR(&gotIpEvent->ip_info.ip),
                        IP2STR(&gotIpEvent->ip_info.gw),
                        IP2STR(&gotIpEvent->ip_info.netmask));
+                gConnectTimeMs.add(static_cast<uint32_t>((esp_timer_get_time() - gContext.attemptStartUs) / 1000));
+                gContext.failedAttempts = 0;
                 xEventGroupSetBits(gWifiEventGroup, WIFI_CONNECTED_FLAG);
+                setState(WifiState::CONNECTED);
                 break;
             }
             
+            default:
+                break;
+        }
+    } else if (eventBase == BOARD_WIFI_EVENT) {
+        switch (eventId) {
+            case BOARD_WIFI_EVENT_RETRY:
+                /* Retry timer may fire right after a user disconnect*/
+                if (gContext.state == WifiState::BACKOFF) {
+                    startAttempt();
+                }
+                break;
+
+            case BOARD_WIFI_EVENT_STOP:
+                stopManager();
+                break;
+
             default:
                 break;
         }
@@ -118,6 +340,21 @@ esp_err_t Board_wifiInit(void) {
                                                         &eventHandler,
                                                         NULL,
                                                         &instance_got_ip));
+    esp_event_handler_instance_t instance_board;
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(BOARD_WIFI_EVENT,
+                                                        ESP_EVENT_ANY_ID,
+                                                        &eventHandler,
+                                                        NULL,
+                                                        &instance_board));
+
+    const esp_timer_create_args_t RetryTimerArgs = {
+        .callback = &retryTimeout,
+        .arg = nullptr,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "wifiRetry",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&RetryTimerArgs, &gContext.retryTimer));
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
 
@@ -149,67 +386,71 @@ esp_err_t Board_wifiDeinit(void) {
     return ESP_OK;
 }
 
-esp_err_t Board_wifiConnect(const itf_wifi_config_t& config, uint32_t timeoutMs) {
-    if (Board_wifiIsConnected()) {
-        ESP_LOGW(TAG, "connect: already connected. Disconnect first");
+esp_err_t Board_wifiStart(const itf_wifi_config_t& config) {
+    if (!Board_wifiIsInited()) {
+        ESP_LOGW(TAG, "start: not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (gContext.state != WifiState::DISCONNECTED) {
+        ESP_LOGW(TAG, "start: already started. Disconnect first");
         return ESP_ERR_INVALID_STATE;
     }
     
-    /* Register callback. Use it in event handler*/
+    /* Register callbacks. Use them in event handler*/
     gContext.failCallBack = config.failCallBack;
+    gContext.stateCallBack = config.stateCallBack;
+
+    gContext.config = {};
+    gContext.config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+    gContext.config.sta.sae_pwe_h2e = WPA3_SAE_PWE_BOTH;
+    std::memcpy(gContext.config.sta.ssid, config.ssid, sizeof(config.ssid));
+    std::memcpy(gContext.config.sta.password, config.password, sizeof(config.password));
+    gContext.failedAttempts = 0;
+    gContext.isUserRequest = false;
+    gContext.tryDirectJoin = true;
+    loadApCache();
+
+    /* First attempt is started by WIFI_EVENT_STA_START*/
+    ESP_RETURN_ON_ERROR(esp_wifi_start(), TAG, "start: wifi start failed");
+    ESP_LOGI(TAG, "start: wifi started%s", gContext.isCacheValid ? ", joining last AP directly" : "");
+    return ESP_OK;
+}
 
-    wifi_config_t wifiConfig {};
-    wifiConfig.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
-    wifiConfig.sta.sae_pwe_h2e = WPA3_SAE_PWE_BOTH;
-    std::memcpy(wifiConfig.sta.ssid, config.ssid, sizeof(config.ssid));
-    std::memcpy(wifiConfig.sta.password, config.password, sizeof(config.password));
+esp_err_t Board_wifiConnect(const itf_wifi_config_t& config, uint32_t timeoutMs) {
+    if (Board_wifiIsConnected()) {
+        ESP_LOGW(TAG, "connect: already connected. Disconnect first");
+        return ESP_ERR_INVALID_STATE;
+    }
+    TRACE_SCOPE("wifi.connect");
 
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifiConfig));
-    ESP_ERROR_CHECK(esp_wifi_start());
-    ESP_LOGI(TAG, "connect: wifi started");
+    xEventGroupClearBits(gWifiEventGroup, WIFI_CONNECTED_FLAG);
+    ESP_RETURN_ON_ERROR(Board_wifiStart(config), TAG, "connect: start failed");
 
-    /* Waiting until either the connection is established (WIFI_CONNECTED_FLAG) or connection failed for the maximum
-     * number of retries (WIFI_FAILED_FLAG). The bits are set by eventHandler() */
-    const EventBits_t flags = xEventGroupWaitBits(gWifiEventGroup, WIFI_CONNECTED_FLAG | WIFI_FAILED_FLAG, pdFALSE, pdFALSE, pdMS_TO_TICKS(timeoutMs));
+    /* Waiting until the connection is established (WIFI_CONNECTED_FLAG), set by eventHandler().
+     * Failed attempts are retried in the background meanwhile*/
+    const EventBits_t flags = xEventGroupWaitBits(gWifiEventGroup, WIFI_CONNECTED_FLAG, pdFALSE, pdFALSE, pdMS_TO_TICKS(timeoutMs));
 
-    if ((flags & (WIFI_CONNECTED_FLAG | WIFI_FAILED_FLAG)) == 0) {
-        /* No flags - timeout occurs*/
-        ESP_LOGE(TAG, "connect: connection timeout after %" PRIu32 " ms", timeoutMs);
+    if ((flags & WIFI_CONNECTED_FLAG) == 0) {
+        ESP_LOGE(TAG, "connect: not connected after %" PRIu32 " ms, retrying in background", timeoutMs);
         return ESP_ERR_TIMEOUT;
     }
-    if (flags & WIFI_CONNECTED_FLAG) {
-        ESP_LOGI(TAG, "connect: connected to AP SSID:%s", config.ssid);
-        return ESP_OK;
-    } else if (flags & WIFI_FAILED_FLAG) {
-        ESP_LOGE(TAG, "connect: failed to connect to AP SSID:%s", config.ssid);
-        return ESP_FAIL;
-    } else {
-        ESP_LOGE(TAG, "connect: unexpected event");
-        return ESP_FAIL;        
-    }
+    ESP_LOGI(TAG, "connect: connected to AP SSID:%s", config.ssid);
+    return ESP_OK;
 }
 
 esp_err_t Board_wifiDisconnect(void) {
-    if (!Board_wifiIsConnected()) {
+    if (gContext.state == WifiState::DISCONNECTED) {
         ESP_LOGI(TAG, "disconnect: not connected yet");
         return ESP_ERR_INVALID_STATE;
     }
 
-    gContext.isUserRequest = true;
-
-    const esp_err_t err = esp_wifi_disconnect();
-    if (err == ESP_ERR_WIFI_NOT_INIT) {
-        ESP_LOGW(TAG, "disconnect: wifi not initialized when trying to disconnect");
-    } else if (err != ESP_OK) {
-        ESP_LOGE(TAG, "disconnect: failed to disconnect wifi");
-    } else {
-        ESP_LOGI(TAG, "disconnect: wifi disconnection initiated");
-    }
-
-    ESP_ERROR_CHECK(esp_wifi_stop());
-
+    /* Stop in the event loop task, so the state machine is not changed under its feet*/
+    xEventGroupClearBits(gWifiEventGroup, WIFI_STOPPED_FLAG);
+    ESP_RETURN_ON_ERROR(esp_event_post(BOARD_WIFI_EVENT, BOARD_WIFI_EVENT_STOP, nullptr, 0, portMAX_DELAY),
+                        TAG, "disconnect: unable to post stop");
+    xEventGroupWaitBits(gWifiEventGroup, WIFI_STOPPED_FLAG, pdFALSE, pdFALSE, portMAX_DELAY);
 
-    return err;
+    return gContext.stopResult;
 }
 
 
@@ -223,3 +464,7 @@ bool Board_wifiIsConnected(void) {
     }
     return esp_netif_is_netif_up(gContext.netif);   
 }
+
+WifiState Board_wifiGetState(void) {
+    return gContext.state;
+}
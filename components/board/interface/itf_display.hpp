@@ -24,9 +24,13 @@ public:
         std::size_t y;
     } point_t;
 
+    // Drawing calls only modify the frame buffer, nothing is shown until present()
     virtual esp_err_t drawPixel(const point_t& point, const color::CRGB& color) = 0;
     virtual esp_err_t clear(void) = 0;
 
+    // Pushes the whole frame buffer to the display in a single transfer
+    virtual esp_err_t present(void) = 0;
+
     virtual bool isSupportBrightnessControl() const = 0;
     virtual esp_err_t setBrightness(const uint8_t level) = 0;
 };
@@ -6,17 +6,43 @@ enum class WifiFailEvents {
     FAIL_UNKNOWN,
 };
 
+enum class WifiState {
+    DISCONNECTED,   ///< Not started or disconnected by the user
+    CONNECTING,     ///< Joining the AP, waiting for an IP
+    CONNECTED,      ///< Got an IP
+    BACKOFF,        ///< Attempt failed or connection lost, retry is scheduled
+};
+
 typedef struct {
     uint8_t ssid[32];
     uint8_t password[64];
     void (*failCallBack)(WifiFailEvents event);
+    void (*stateCallBack)(WifiState state);   ///< Optional, called from the event loop task
 } itf_wifi_config_t;
 
 esp_err_t Board_wifiInit(void);
 esp_err_t Board_wifiDeinit(void);
 
+/**
+ * @brief Start the connection manager and return at once
+ * @details The manager joins the last good AP directly by BSSID and channel, falls back to
+ * a full scan and reconnects in the background with exponential backoff until
+ * Board_wifiDisconnect(). State changes are published through config.stateCallBack.
+ */
+esp_err_t Board_wifiStart(const itf_wifi_config_t& config);
+
+/**
+ * @brief Start the connection manager and wait until connected
+ * @retval ESP_ERR_TIMEOUT if not connected within timeoutMs, the manager keeps retrying
+ */
 esp_err_t Board_wifiConnect(const itf_wifi_config_t& config, uint32_t timeoutMs);
+
+/**
+ * @brief Stop the connection manager and wait until it is stopped
+ * @note Do not call from the event loop task, e.g. from stateCallBack
+ */
 esp_err_t Board_wifiDisconnect(void);
 
 bool Board_wifiIsInited(void);
-bool Board_wifiIsConnected(void);
\ No newline at end of file
+bool Board_wifiIsConnected(void);
+WifiState Board_wifiGetState(void);
@@ -0,0 +1,171 @@
+/**
+ * @brief Compile-time mapping of matrix coordinates to LED strip indices
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace layout {
+
+    /**
+     * @enum Wiring
+     * @brief Order in which rows of LEDs (or panels of a tiled display) are chained
+     */
+    enum class Wiring {
+        PROGRESSIVE, ///< Every row starts from the left edge
+        SERPENTINE,  ///< Odd rows run backwards (zigzag)
+    };
+
+    /**
+     * @enum Rotation
+     * @brief Clockwise rotation of the logical image relative to the wired layout
+     */
+    enum class Rotation {
+        R0,
+        R90,
+        R180,
+        R270,
+    };
+
+    /**
+     * @enum Mirror
+     * @brief Mirroring of the logical image, applied before rotation
+     */
+    enum class Mirror {
+        NONE,
+        HORIZONTAL, ///< Flip x axis
+        VERTICAL,   ///< Flip y axis
+        BOTH,
+    };
+
+    /**
+     * @brief Position of cell (x,y) in a chain of rows wired in given order
+     */
+    constexpr std::size_t chainIndex(std::size_t x, std::size_t y, std::size_t width, Wiring wiring) {
+        const bool Reversed = (wiring == Wiring::SERPENTINE) && (y % 2);
+        return y * width + (Reversed ? width - 1 - x : x);
+    }
+
+    /**
+     * @struct Panel
+     * @brief Single LED panel, first LED at top-left corner, chained row by row
+     */
+    template<std::size_t Width, std::size_t Height, Wiring Wire = Wiring::SERPENTINE>
+    struct Panel {
+        static constexpr std::size_t width = Width;
+        static constexpr std::size_t height = Height;
+        static constexpr std::size_t ledCount = Width * Height;
+
+        static constexpr std::size_t index(std::size_t x, std::size_t y) {
+            return chainIndex(x, y, Width, Wire);
+        }
+    };
+
+    /**
+     * @struct Tiled
+     * @brief Grid of identical panels chained one after another
+     * @tparam PanelLayout Layout of a single panel
+     * @tparam TileWiring Order in which panels are chained
+     */
+    template<typename PanelLayout, std::size_t TilesX, std::size_t TilesY, Wiring TileWiring = Wiring::PROGRESSIVE>
+    struct Tiled {
+        static constexpr std::size_t width = PanelLayout::width * TilesX;
+        static constexpr std::size_t height = PanelLayout::height * TilesY;
+        static constexpr std::size_t ledCount = width * height;
+
+        static constexpr std::size_t index(std::size_t x, std::size_t y) {
+            const std::size_t Tile = chainIndex(x / PanelLayout::width, y / PanelLayout::height, TilesX, TileWiring);
+            return Tile * PanelLayout::ledCount + PanelLayout::index(x % PanelLayout::width, y % PanelLayout::height);
+        }
+    };
+
+    /**
+     * @struct Transformed
+     * @brief Rotated and/or mirrored view of another layout
+     */
+    template<typename Base, Rotation Rot = Rotation::R0, Mirror Mir = Mirror::NONE>
+    struct Transformed {
+        static constexpr bool Swapped = (Rot == Rotation::R90 || Rot == Rotation::R270);
+        static constexpr std::size_t width = Swapped ? Base::height : Base::width;
+        static constexpr std::size_t height = Swapped ? Base::width : Base::height;
+        static constexpr std::size_t ledCount = Base::ledCount;
+
+        static constexpr std::size_t index(std::size_t x, std::size_t y) {
+            if (Mir == Mirror::HORIZONTAL || Mir == Mirror::BOTH) {
+                x = width - 1 - x;
+            }
+            if (Mir == Mirror::VERTICAL || Mir == Mirror::BOTH) {
+                y = height - 1 - y;
+            }
+
+            switch (Rot) {
+                case Rotation::R90:
+                    return Base::index(y, Base::height - 1 - x);
+                case Rotation::R180:
+                    return Base::index(Base::width - 1 - x, Base::height - 1 - y);
+                case Rotation::R270:
+                    return Base::index(Base::width - 1 - y, x);
+                case Rotation::R0:
+                default:
+                    return Base::index(x, y);
+            }
+        }
+    };
+
+    template<typename Layout>
+    using Table = std::array<uint16_t, Layout::width * Layout::height>;
+
+    template<typename Layout>
+    constexpr Table<Layout> makeTable(void) {
+        Table<Layout> table{};
+        for (std::size_t y = 0; y < Layout::height; y++) {
+            for (std::size_t x = 0; x < Layout::width; x++) {
+                table[y * Layout::width + x] = static_cast<uint16_t>(Layout::index(x, y));
+            }
+        }
+        return table;
+    }
+
+    /**
+     * @brief Check that every LED is addressed exactly once
+     */
+    template<typename Layout>
+    constexpr bool isBijective(const Table<Layout>& table) {
+        std::array<bool, Layout::width * Layout::height> used{};
+        for (const auto Index : table) {
+            if (Index >= used.size() || used[Index]) {
+                return false;
+            }
+            used[Index] = true;
+        }
+        return true;
+    }
+
+    /**
+     * @struct Map
+     * @brief Coordinate to LED index lookup table generated at compile time
+     * @tparam Layout Any of Panel, Tiled or Transformed
+     */
+    template<typename Layout>
+    struct Map {
+        static constexpr std::size_t width = Layout::width;
+        static constexpr std::size_t height = Layout::height;
+        static constexpr std::size_t ledCount = width * height;
+
+        static_assert(ledCount > 0 && ledCount <= UINT16_MAX + 1, "layout does not fit 16-bit LED index");
+
+        static constexpr Table<Layout> table = makeTable<Layout>();
+
+        static_assert(isBijective<Layout>(table), "layout must address every LED exactly once");
+
+        /**
+         * @brief LED index of (x,y), coordinates must be in range
+         */
+        static constexpr std::size_t index(std::size_t x, std::size_t y) {
+            return table[y * width + x];
+        }
+    };
+}
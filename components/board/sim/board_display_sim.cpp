@@ -0,0 +1,157 @@
+#include "board_display_sim.hpp"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+
+#include "esp_log.h"
+#include "esp_check.h"
+
+static const char *TAG = "board_display_sim";
+
+/* No GPIO on the host, the strip only keeps the number*/
+static const gpio_num_t DisplayConnPin = 0;
+
+static int64_t monotonicUs(void) {
+    const auto Now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(Now).count();
+}
+
+SimDisplay::~SimDisplay() {
+    delete ledStrip_;
+    if (timestampsFile_) {
+        fclose(timestampsFile_);
+    }
+}
+
+esp_err_t SimDisplay::init(const ILedMatrixDisplay::resolution_t& resolution) {
+    if (resolution.x != DisplayLayout::width || resolution.y != DisplayLayout::height) {
+        ESP_LOGE(TAG, "init: %dx%d resolution does not match %dx%d board layout",
+                 (int)resolution.x, (int)resolution.y, (int)DisplayLayout::width, (int)DisplayLayout::height);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ppmDir_ = getenv("TEXT_CLOCK_SIM_PPM_DIR");
+    ansi_ = getenv("TEXT_CLOCK_SIM_ANSI") != nullptr;
+    if (const char* path = getenv("TEXT_CLOCK_SIM_TIMESTAMPS")) {
+        timestampsFile_ = fopen(path, "a");
+        ESP_RETURN_ON_FALSE(timestampsFile_, ESP_FAIL, TAG, "init: failed to open %s", path);
+    }
+
+    resolution_ = resolution;
+    output_.assign(DisplayLayout::ledCount, color::CRGB::Black);
+
+    /* Same settings as the device display*/
+    ledStrip_ = new DisplayStrip(DisplayLayout::ledCount, DisplayConnPin);
+    ledStrip_->setGamma(DISPLAY_GAMMA);
+    ledStrip_->setDithering(true);
+    ledStrip_->setUpdateMode(UpdateMode::ASYNC);
+    ESP_RETURN_ON_ERROR(ledStrip_->update(), TAG, "init: failed to update ledstrip buffer");
+
+    /* Blank frame of init is not a presented one*/
+    ledStrip_->setFrameSink([this](const uint8_t* data, std::size_t size, bool changed) {
+        onFrame(data, size, changed);
+    });
+
+    isInited_ = true;
+    ESP_LOGI(TAG, "init: simulated %dx%d display, ppm: %s, ansi: %s", (int)resolution_.x, (int)resolution_.y,
+             ppmDir_ ? ppmDir_ : "off", ansi_ ? "on" : "off");
+
+    return ESP_OK;
+}
+
+ILedMatrixDisplay::resolution_t SimDisplay::getResolution(void) const {
+    return resolution_;
+}
+
+esp_err_t SimDisplay::drawPixel(const point_t& point, const color::CRGB& color) {
+    ESP_RETURN_ON_FALSE(isInited_, ESP_FAIL, TAG, "drawPixel: not inited");
+
+    if (point.x >= resolution_.x || point.y >= resolution_.y) {
+        ESP_LOGE(TAG, "drawPixel: x:%d,y:%d - no such point", (int)point.x, (int)point.y);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return ledStrip_->setColor(color, DisplayLayout::index(point.x, point.y));
+}
+
+esp_err_t SimDisplay::clear(void) {
+    ESP_RETURN_ON_FALSE(isInited_, ESP_FAIL, TAG, "clear: not inited");
+
+    ledStrip_->clear();
+    return ESP_OK;
+}
+
+esp_err_t SimDisplay::present(void) {
+    ESP_RETURN_ON_FALSE(isInited_, ESP_FAIL, TAG, "present: not inited");
+
+    if (timestampsFile_) {
+        fprintf(timestampsFile_, "%zu,%" PRId64 "\n", frameCount_, monotonicUs());
+        fflush(timestampsFile_);
+    }
+
+    /* Sink renders the frame from within update(), if the strip sends one*/
+    const esp_err_t Ret = ledStrip_->update();
+    frameCount_++;
+    ESP_RETURN_ON_ERROR(Ret, TAG, "present: failed to update led strip buffer");
+
+    return ESP_OK;
+}
+
+esp_err_t SimDisplay::setBrightness(const uint8_t level) {
+    ESP_RETURN_ON_FALSE(isInited_, ESP_FAIL, TAG, "setBrightness: not inited");
+
+    ledStrip_->setBrightness(level);
+    return ESP_OK;
+}
+
+void SimDisplay::onFrame(const uint8_t* data, std::size_t size, bool changed) {
+    using Pixel = LedTypeSpecific<DisplayLedType>::ColorFormat;
+    if (!changed || size != DisplayLayout::ledCount * sizeof(Pixel)) {
+        return;
+    }
+
+    /* Wire is in strip order and color format, back to matrix order RGB*/
+    const Pixel* Leds = reinterpret_cast<const Pixel*>(data);
+    for (std::size_t y = 0; y < DisplayLayout::height; y++) {
+        for (std::size_t x = 0; x < DisplayLayout::width; x++) {
+            output_[y * DisplayLayout::width + x] = Leds[DisplayLayout::index(x, y)].toRGB();
+        }
+    }
+
+    if (ppmDir_) {
+        writePpm();
+    }
+    if (ansi_) {
+        drawAnsi();
+    }
+}
+
+void SimDisplay::writePpm(void) const {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/frame_%06zu.ppm", ppmDir_, frameCount_);
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        ESP_LOGE(TAG, "writePpm: failed to open %s", path);
+        return;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", (int)DisplayLayout::width, (int)DisplayLayout::height);
+    fwrite(output_.data(), sizeof(color::CRGB), output_.size(), file);
+    fclose(file);
+}
+
+void SimDisplay::drawAnsi(void) const {
+    /* Cursor home, then two character wide cells per pixel*/
+    printf("\x1b[H");
+    for (std::size_t y = 0; y < DisplayLayout::height; y++) {
+        for (std::size_t x = 0; x < DisplayLayout::width; x++) {
+            const color::CRGB& Pixel = output_[y * DisplayLayout::width + x];
+            printf("\x1b[48;2;%d;%d;%dm  ", Pixel.r, Pixel.g, Pixel.b);
+        }
+        printf("\x1b[0m\n");
+    }
+    printf("frame %zu\n", frameCount_);
+    fflush(stdout);
+}
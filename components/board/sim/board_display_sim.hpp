@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "itf_display.hpp"
+#include "board_display_config.hpp"
+#include "esp_err.h"
+
+/**
+ * @brief Host (linux target) display, drives the host LED strip and renders the frames it sends
+ * @details Pixels go through the same layout, gamma, dithering and change tracking as on the
+ * device. Output is taken from the strip frame sink and mapped back to the matrix.
+ *
+ * Output is selected with environment variables:
+ * - TEXT_CLOCK_SIM_PPM_DIR     write every changed frame to <dir>/frame_NNNNNN.ppm
+ * - TEXT_CLOCK_SIM_ANSI        draw changed frames in the terminal with 24-bit ANSI colors
+ * - TEXT_CLOCK_SIM_TIMESTAMPS  append "<frame>,<us>" line per present to the given file
+ */
+class SimDisplay : public ILedMatrixDisplay {
+public:
+    SimDisplay() = default;
+    ~SimDisplay();
+
+    esp_err_t init(const ILedMatrixDisplay::resolution_t& resolution);
+
+    resolution_t getResolution(void) const;
+
+    esp_err_t drawPixel(const point_t& point, const color::CRGB& color);
+
+    esp_err_t clear(void);
+
+    esp_err_t present(void);
+
+    bool isSupportBrightnessControl(void) const {
+        return true;
+    }
+
+    esp_err_t setBrightness(const uint8_t level);
+
+    /**
+     * @brief Number of presented frames
+     */
+    std::size_t getFrameCount(void) const {
+        return frameCount_;
+    }
+
+private:
+    /**
+     * @brief Strip frame sink, renders frames whose content changed
+     */
+    void onFrame(const uint8_t* data, std::size_t size, bool changed);
+
+    void writePpm(void) const;
+    void drawAnsi(void) const;
+
+    bool isInited_ = false;
+    ILedMatrixDisplay::resolution_t resolution_ = {0, 0};
+    DisplayStrip *ledStrip_ = nullptr;
+    std::vector<color::CRGB> output_;   ///< Last sent frame in matrix order
+    std::size_t frameCount_ = 0;
+    const char* ppmDir_ = nullptr;
+    bool ansi_ = false;
+    FILE* timestampsFile_ = nullptr;
+};
@@ -0,0 +1,64 @@
+#include "itf_wifi.hpp"
+#include "esp_log.h"
+
+/* Host build: networking is provided by the host OS, there is nothing to bring up*/
+
+static const char *TAG = "board_wifi_sim";
+
+static bool gIsInited = false;
+static WifiState gState = WifiState::DISCONNECTED;
+
+esp_err_t Board_wifiInit(void) {
+    if (gIsInited) {
+        ESP_LOGW(TAG, "init: already initialized");
+        return ESP_FAIL;
+    }
+
+    gIsInited = true;
+    ESP_LOGI(TAG, "init: using host network");
+    return ESP_OK;
+}
+
+esp_err_t Board_wifiDeinit(void) {
+    gState = WifiState::DISCONNECTED;
+    gIsInited = false;
+    return ESP_OK;
+}
+
+esp_err_t Board_wifiStart(const itf_wifi_config_t& config) {
+    if (!gIsInited || gState != WifiState::DISCONNECTED) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    gState = WifiState::CONNECTED;
+    ESP_LOGI(TAG, "start: pretending to join SSID:%s", reinterpret_cast<const char*>(config.ssid));
+    if (config.stateCallBack) {
+        config.stateCallBack(gState);
+    }
+    return ESP_OK;
+}
+
+esp_err_t Board_wifiConnect(const itf_wifi_config_t& config, uint32_t timeoutMs) {
+    return Board_wifiStart(config);
+}
+
+esp_err_t Board_wifiDisconnect(void) {
+    if (gState == WifiState::DISCONNECTED) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    gState = WifiState::DISCONNECTED;
+    return ESP_OK;
+}
+
+bool Board_wifiIsInited(void) {
+    return gIsInited;
+}
+
+bool Board_wifiIsConnected(void) {
+    return gState == WifiState::CONNECTED;
+}
+
+WifiState Board_wifiGetState(void) {
+    return gState;
+}
@@ -2,21 +2,54 @@
  * @brief LED Strip Controller for ESP32 RMT Peripheral
  * @author Igor Naskin
  * @date 09.05.2025
+ *
+ * On the linux target there is no RMT, the strip keeps the same pixel pipeline
+ * and hands encoded output bytes over to a frame sink instead of the wire.
+ *
+ * A strip can be split into segments driven by separate GPIOs/RMT channels,
+ * segments are transmitted in parallel so frame time scales down with their number.
+ *
+ * Frames are triple buffered: callers draw into the LED buffer while up to two
+ * submitted frames are queued or on the wire, see UpdateMode.
  */
 
 #pragma once
 
 #include <vector>
+#include <array>
+#include <bitset>
+#include <algorithm>
+#include <type_traits>
+#include <cmath>
+#include <functional>
+#include <cassert>
+#include <atomic>
+#include "sdkconfig.h"
+#if CONFIG_IDF_TARGET_LINUX
+/* No GPIO matrix on host, pin number is only kept for reference*/
+typedef int gpio_num_t;
+#else
 #include "hal/gpio_types.h"
 #include "driver/rmt_tx.h"
+#include "soc/soc_caps.h"
+#endif
 #include "color.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
 #include "esp_check.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include <cstdint>
 
 
 namespace addressable_led {
     static const char *TAG = "addressable_led";
+
+    /* Shared by all strips, one set of numbers per device*/
+    inline metrics::Counter FramesSent {"led.frames"};
+    inline metrics::Counter TransmitFailures {"led.tx_fail"};
+    inline metrics::Histogram RmtWaitUs {"led.rmt_wait_us"};
 };
 
 /**
@@ -25,6 +58,9 @@ namespace addressable_led {
  */
 enum class LedType {
     WS2812B,
+    WS2811,  ///< 800 kHz (high speed) mode
+    WS2815,  ///< 12V, backup data line is not driven
+    SK6812,  ///< RGBW
 };
 
 /**
@@ -36,13 +72,23 @@ enum class Rating {
     PERFOMANCE, ///< Higher performance with increased memory usage
 };
 
+/**
+ * @enum UpdateMode
+ * @brief How update() hands frames over to RMT
+ */
+enum class UpdateMode {
+    BLOCKING, ///< Wait for the previous frame to leave the wire before submitting the next one
+    ASYNC,    ///< Queue the frame behind the one on the wire, wait only if both output buffers are busy
+};
+
 /**
  * @struct LedTypeSpecific
  * @tparam Type The LED type to specialize for
  * @brief Provides type-specific traits for different LED strips
  * 
  * Specializations should define:
- * - Data transmission timing properties
+ * - Data transmission timing properties, integer nanoseconds (checked at compile time)
+ * - Reset (latch) time
  * - Color format
  */
 template<LedType Type>
@@ -54,14 +100,154 @@ struct LedTypeSpecific;
 template<>
 struct LedTypeSpecific<LedType::WS2812B> {
     static constexpr bool msbFirst = true; ///< Data transmission order
-    static constexpr float T0H_us = 0.3f;  ///< Duration of '0' bit high signal (μs)
-    static constexpr float T0L_us = 0.9f;  ///< Duration of '0' bit low signal (μs)
-    static constexpr float T1H_us = 0.9f;  ///< Duration of '1' bit high signal (μs)
-    static constexpr float T1L_us = 0.3f;  ///< Duration of '1' bit low signal (μs)
+    static constexpr uint32_t T0H_ns = 300;  ///< Duration of '0' bit high signal (ns)
+    static constexpr uint32_t T0L_ns = 900;  ///< Duration of '0' bit low signal (ns)
+    static constexpr uint32_t T1H_ns = 900;  ///< Duration of '1' bit high signal (ns)
+    static constexpr uint32_t T1L_ns = 300;  ///< Duration of '1' bit low signal (ns)
+    static constexpr uint32_t Reset_us = 50; ///< Low level latching the data (μs)
+
+    using ColorFormat = color::CGRB; ///< Green-Red-Blue color format
+};
+
+/**
+ * @brief Specialization for WS2811 driver ICs in high speed mode
+ */
+template<>
+struct LedTypeSpecific<LedType::WS2811> {
+    static constexpr bool msbFirst = true;
+    static constexpr uint32_t T0H_ns = 250;
+    static constexpr uint32_t T0L_ns = 1000;
+    static constexpr uint32_t T1H_ns = 600;
+    static constexpr uint32_t T1L_ns = 650;
+    static constexpr uint32_t Reset_us = 50;
+
+    using ColorFormat = color::CRGBOrder; ///< Red-Green-Blue color format
+};
+
+/**
+ * @brief Specialization for WS2815 LED strips
+ */
+template<>
+struct LedTypeSpecific<LedType::WS2815> {
+    static constexpr bool msbFirst = true;
+    static constexpr uint32_t T0H_ns = 300;
+    static constexpr uint32_t T0L_ns = 800;
+    static constexpr uint32_t T1H_ns = 800;
+    static constexpr uint32_t T1L_ns = 300;
+    static constexpr uint32_t Reset_us = 280; ///< WS2813 family needs much longer latch
 
     using ColorFormat = color::CGRB; ///< Green-Red-Blue color format
 };
 
+/**
+ * @brief Specialization for SK6812 RGBW LED strips
+ */
+template<>
+struct LedTypeSpecific<LedType::SK6812> {
+    static constexpr bool msbFirst = true;
+    static constexpr uint32_t T0H_ns = 300;
+    static constexpr uint32_t T0L_ns = 900;
+    static constexpr uint32_t T1H_ns = 600;
+    static constexpr uint32_t T1L_ns = 600;
+    static constexpr uint32_t Reset_us = 80;
+
+    using ColorFormat = color::CGRBW; ///< Green-Red-Blue-White color format, white is extracted from RGB
+};
+
+namespace addressable_led {
+    constexpr uint32_t RmtResolutionHz = 10'000'000; ///< 0.1us tick which is sufficient for all supported timings
+    constexpr uint32_t TickNs = 1'000'000'000 / RmtResolutionHz;
+    constexpr uint32_t MaxSymbolTicks = 0x7FFF;      ///< 15-bit duration of a symbol half
+    constexpr size_t SymbolsPerByte = 8;             ///< One RMT symbol per data bit
+
+    /**
+     * @brief Convert duration to RMT ticks, rounded to nearest
+     */
+    constexpr uint32_t toTicks(uint32_t durationNs) {
+        return (durationNs + TickNs / 2) / TickNs;
+    }
+
+    /**
+     * @brief Pack high/low pulse durations into a raw RMT symbol word
+     * @param highNs Duration of high level (ns)
+     * @param lowNs Duration of low level (ns)
+     * @param highLevel Level of the first half of symbol
+     * @return uint32_t Value of rmt_symbol_word_t::val
+     */
+    constexpr uint32_t makeSymbol(uint32_t highNs, uint32_t lowNs, uint32_t highLevel = 1) {
+        return toTicks(highNs) | (highLevel << 15) | (toTicks(lowNs) << 16);
+    }
+
+    /**
+     * @brief Compile-time check of LED type timings against RMT limits
+     */
+    template<LedType Type>
+    struct TimingCheck {
+        using Traits = LedTypeSpecific<Type>;
+
+        static_assert(toTicks(Traits::T0H_ns) > 0 && toTicks(Traits::T0L_ns) > 0 &&
+                      toTicks(Traits::T1H_ns) > 0 && toTicks(Traits::T1L_ns) > 0,
+                      "bit timing is shorter than RMT tick");
+        static_assert(toTicks(Traits::T0H_ns) <= MaxSymbolTicks && toTicks(Traits::T0L_ns) <= MaxSymbolTicks &&
+                      toTicks(Traits::T1H_ns) <= MaxSymbolTicks && toTicks(Traits::T1L_ns) <= MaxSymbolTicks,
+                      "bit timing does not fit RMT symbol");
+        static_assert(toTicks(Traits::T1H_ns) > toTicks(Traits::T0H_ns),
+                      "'1' bit must be high longer than '0' bit");
+        static_assert(Traits::Reset_us >= 50 && toTicks(Traits::Reset_us * 1000 / 2) <= MaxSymbolTicks,
+                      "reset time must be at least 50us and fit a single RMT symbol");
+        static_assert(sizeof(typename Traits::ColorFormat) == Traits::ColorFormat::Width,
+                      "color format must be packed");
+
+        static constexpr bool Valid = true;
+    };
+
+    /**
+     * @brief Reset code of LED type, low level for the whole symbol
+     */
+    template<LedType Type>
+    constexpr uint32_t makeResetSymbol(void) {
+        static_assert(TimingCheck<Type>::Valid);
+        const uint32_t HalfNs = LedTypeSpecific<Type>::Reset_us * 1000 / 2;
+        return makeSymbol(HalfNs, HalfNs, 0);
+    }
+
+    /**
+     * @brief Temporal dithering offsets added to 8.8 fixed point output before truncation
+     * @details Over 8 consecutive frames a channel is rounded up as often as its fractional part
+     * says, so average light output keeps the 16-bit precision of the output table
+     */
+    constexpr std::array<uint8_t, 8> DitherOffsets = {0, 128, 64, 192, 32, 160, 96, 224};
+
+    using SymbolTable = std::array<std::array<uint32_t, SymbolsPerByte>, 256>;
+
+    /**
+     * @brief Build byte value to RMT symbols table from LED type timings
+     * @tparam Type The LED type to build table for
+     */
+    template<LedType Type>
+    constexpr SymbolTable makeSymbolTable(void) {
+        static_assert(TimingCheck<Type>::Valid);
+        using Traits = LedTypeSpecific<Type>;
+        const uint32_t Bit0 = makeSymbol(Traits::T0H_ns, Traits::T0L_ns);
+        const uint32_t Bit1 = makeSymbol(Traits::T1H_ns, Traits::T1L_ns);
+
+        SymbolTable table{};
+        for (size_t value = 0; value < table.size(); value++) {
+            for (size_t bit = 0; bit < SymbolsPerByte; bit++) {
+                const size_t Shift = Traits::msbFirst ? (SymbolsPerByte - 1 - bit) : bit;
+                table[value][bit] = ((value >> Shift) & 1) ? Bit1 : Bit0;
+            }
+        }
+        return table;
+    }
+
+    template<LedType Type>
+    inline constexpr SymbolTable SymbolTableFor = makeSymbolTable<Type>();
+
+    template<LedType Type>
+    inline constexpr uint32_t ResetSymbolFor = makeResetSymbol<Type>();
+};
+
 template<LedType Type>
 class AddresableLED {
 public:
@@ -70,16 +256,51 @@ public:
      * @param ledCount Number of LEDs in the strip
      * @param connPin GPIO pin connected to LED data line
      * @param rating Performance configuration
+     * @note RMT setup errors do not abort, check getInitError()
      */
     AddresableLED(const std::size_t ledCount, const gpio_num_t connPin, const Rating rating = Rating::DEFAULT);
 
+    /**
+     * @brief Construct a LED Strip controller driving the strip as parallel segments
+     * @details LEDs are split into connPins.size() consecutive segments of (nearly) equal length,
+     * segment k is wired to connPins[k] and owns its own RMT channel. Segments are started
+     * together by RMT sync manager where the chip supports it, otherwise back to back
+     * @param ledCount Number of LEDs in the whole strip
+     * @param connPins GPIO pins connected to data lines of the segments, in strip order
+     * @param rating Performance configuration of every channel
+     * @note RMT setup errors do not abort, check getInitError()
+     */
+    AddresableLED(const std::size_t ledCount, const std::vector<gpio_num_t>& connPins, const Rating rating = Rating::DEFAULT);
+
+    /**
+     * @brief Release RMT channel and encoder
+     */
+    ~AddresableLED();
+
+    /* Encoder keeps a pointer to the instance*/
+    AddresableLED(const AddresableLED&) = delete;
+    AddresableLED& operator=(const AddresableLED&) = delete;
+
     /**
      * @brief Set global brightness level
      * @param level Brightness value (0-255)
-     * @note Applies to all subsequent color operations
+     * @note Applied on output only, stored colors are kept untouched
      */
     void setBrightness(uint8_t level);
 
+    /**
+     * @brief Set gamma correction of output values
+     * @param gamma Exponent, 1.0 keeps output linear (default), 2.2 matches perceived brightness
+     */
+    void setGamma(float gamma);
+
+    /**
+     * @brief Enable temporal dithering of low output levels
+     * @note Dithering advances by one step per transmitted frame, so it needs update() to be
+     * called at display refresh rate, frames are then retransmitted even when unchanged
+     */
+    void setDithering(bool enable);
+
     /**
      * @brief Set color of a single LED
      * @param color Color in CRGB format
@@ -99,6 +320,16 @@ public:
      */
     esp_err_t setColor(const color::CRGB& color, size_t startIndex, size_t count);
 
+    /**
+     * @brief Set colors of a range of LEDs from a buffer
+     * @param colors Colors in CRGB format, count elements
+     * @param startIndex First LED to set (0-based)
+     * @param count Number of LEDs to set
+     * @return esp_err_t ESP_OK on success, error code on failure
+     * @retval ESP_ERR_INVALID_SIZE if range is invalid
+     */
+    esp_err_t setColors(const color::CRGB* colors, size_t startIndex, size_t count);
+
     /**
      * @brief Turn off all LEDs
      * @note Uses the LED type's Black color definition
@@ -107,78 +338,284 @@ public:
 
     /**
      * @brief Push color data to LED strip
+     * @note Returns immediately if neither colors nor brightness changed since last transmission,
+     * unless periodic refresh is due
      * @return esp_err_t ESP_OK on success, error code on failure
      * @retval RSLT_ERR_TIMEOUT if RMT peripheral is busy
      * @retval ESP_FAIL if transmission fails
      */
     esp_err_t update(void);
 
+    /**
+     * @brief Select how update() waits for previous frames
+     * @note Switching to BLOCKING takes effect on the next update()
+     */
+    void setUpdateMode(UpdateMode mode) {
+        mode_ = mode;
+    }
+
+    /**
+     * @brief Called once a frame is fully transmitted on every segment
+     * @warning Runs in RMT ISR context on the device, must be short and ISR safe
+     */
+    using FrameDoneCallback = void (*)(void* arg);
+
+    /**
+     * @brief Set frame completion callback
+     * @param callback Function to call, nullptr disables notification
+     * @param arg Passed to callback as is
+     */
+    void setFrameDoneCallback(FrameDoneCallback callback, void* arg) {
+        frameDoneCallback_ = callback;
+        frameDoneArg_ = arg;
+    }
+
+    /**
+     * @brief Wait until all submitted frames are transmitted
+     * @param timeoutMs Maximum time to wait
+     * @return esp_err_t
+     * @retval ESP_ERR_TIMEOUT if frames are still on the wire
+     */
+    esp_err_t waitDone(uint32_t timeoutMs);
+
+    /**
+     * @brief Force retransmission of unchanged data every intervalMs
+     * @param intervalMs Refresh interval in milliseconds, 0 disables forced refresh
+     * @note Guards against glitches latched by LEDs, e.g. due to line noise
+     */
+    void setRefreshInterval(uint32_t intervalMs);
+
+    /**
+     * @brief Result of RMT setup, a strip which failed it transmits nothing
+     * @return esp_err_t ESP_OK if channels, encoders and frames were created
+     */
+    esp_err_t getInitError(void) const {
+#if CONFIG_IDF_TARGET_LINUX
+        return ESP_OK;
+#else
+        return initError_;
+#endif
+    }
+
+    /**
+     * @brief Number of segments transmitted in parallel
+     */
+    size_t getSegmentCount(void) const {
+        return segments_.size();
+    }
+
+    /**
+     * @brief Encode output bytes into raw RMT symbol words
+     * @details Applies gamma, brightness and dithering of the current frame and maps every
+     * resulting bit to an RMT symbol through the type specific symbol table
+     * @param bytes Frame data
+     * @param index Index of the first byte to encode within the frame, selects dithering step
+     * @param count Number of bytes to encode
+     * @param symbols Output, count * 8 words
+     * @param ditherPhase Dithering step of the frame
+     */
+    void encodeSymbols(const uint8_t* bytes, size_t index, size_t count, uint32_t* symbols, uint8_t ditherPhase) const {
+        encodeSymbols(outputLut_, bytes, index, count, symbols, ditherPhase);
+    }
+
+    /**
+     * @brief Output byte (after gamma, brightness and dithering) of a frame byte
+     */
+    uint8_t outputByte(uint8_t value, size_t index, uint8_t ditherPhase) const {
+        return outputByte(outputLut_, value, index, ditherPhase);
+    }
+
+#if CONFIG_IDF_TARGET_LINUX
+    /**
+     * @brief Receives every transmitted frame as wire ordered output bytes
+     * @details changed is false for retransmissions of the same content (refresh, dithering steps)
+     */
+    using FrameSink = std::function<void(const uint8_t* data, size_t size, bool changed)>;
+
+    void setFrameSink(FrameSink sink) {
+        frameSink_ = std::move(sink);
+    }
+#endif
+
 private:
+    using OutputLut = std::array<uint16_t, 256>; ///< Channel value to 8.8 fixed point output value
+
+    static uint8_t outputByte(const OutputLut& lut, uint8_t value, size_t index, uint8_t ditherPhase) {
+        const uint8_t DitherOffset = addressable_led::DitherOffsets[(ditherPhase + index) % addressable_led::DitherOffsets.size()];
+        return (lut[value] + DitherOffset) >> 8;
+    }
+
+    static void encodeSymbols(const OutputLut& lut, const uint8_t* bytes, size_t index, size_t count,
+                              uint32_t* symbols, uint8_t ditherPhase);
+
     /**
-     * @brief Apply current brightness to all LEDs
+     * @brief Rebuild output table from brightness, gamma and dithering settings
      */
-    void applyBrightness(void);
+    void rebuildOutputLut(void);
 
     /**
-     * @brief RMT encoder structure for LED protocol
+     * @brief Hash of LED colors and brightness, detects frames equal to the transmitted one
      */
-    struct RmtLedStripEncoder {
-        rmt_encoder_t base;            ///< Base encoder interface
-        rmt_encoder_t* bytes_encoder;  ///< Bytes encoder handle
-        rmt_encoder_t* copy_encoder;   ///< Copy encoder handle
-        int state;                     ///< Current encoder state
-        rmt_symbol_word_t reset_code;  ///< Reset code timing
-    };
+    uint32_t contentHash(void) const;
 
     /**
-     * @brief Create RMT encoder for LED protocol
-     * @param encoder Encoder structure to initialize
-     * @param resolutionHz RMT resolution in Hz
-     * @return esp_err_t ESP_OK on success, error code on failure
+     * @brief Whether any LED channel hits a fractional output level, only those frames need dithering
+     */
+    bool contentNeedsDither(void) const;
+
+    static constexpr size_t OutputFrames = 2; ///< Queued + on the wire, drawing buffer makes the third
+
+    /**
+     * @struct segment_t
+     * @brief Part of the strip behind a single data line
+     */
+    typedef struct {
+        size_t start;    ///< First LED of the segment
+        size_t count;    ///< Number of LEDs
+        gpio_num_t pin;  ///< Data line
+#if !CONFIG_IDF_TARGET_LINUX
+        AddresableLED* owner;               ///< Strip the segment belongs to
+        rmt_channel_handle_t channel;       ///< RMT channel handle
+        rmt_encoder_handle_t encoder;       ///< RMT encoder handle, encoders keep per transaction state
+        /* RMT completes transactions of a channel in order, so the ring tells which frame is done*/
+        std::array<uint8_t, OutputFrames> inFlight; ///< Output frames submitted to the channel
+        uint32_t head;                      ///< Next frame to complete, advanced in ISR only
+        uint32_t tail;                      ///< Next free ring slot, advanced by submitter only
+        bool enabled;                       ///< Channel is enabled
+#endif
+    } segment_t;
+
+    /**
+     * @struct frame_t
+     * @brief Output frame owned by RMT from submission until every segment is done
      */
-    static esp_err_t create_encoder(RmtLedStripEncoder* encoder, uint32_t resolutionHz);
+    typedef struct {
+        std::vector<typename LedTypeSpecific<Type>::ColorFormat> leds; ///< Snapshot of LED colors
+        OutputLut lut;                         ///< Output table the frame is encoded with, rebuilds do not touch it
+        uint32_t lutVersion;                   ///< Version of the strip table lut is a copy of
+        uint8_t ditherPhase;                   ///< Dithering step the frame is encoded with
+        std::atomic<uint32_t> pendingSegments; ///< Segments still transmitting, frame is free at 0
+    } frame_t;
 
+#if !CONFIG_IDF_TARGET_LINUX
     /**
-     * @brief RMT encoder callback function
-     * @param encoder Encoder handle
-     * @param channel RMT channel handle
-     * @param primary_data Data to encode
-     * @param data_size Size of data
-     * @param ret_state Encoder state
-     * @return size_t Number of symbols encoded
+     * @brief RMT simple encoder callback, runs in RMT ISR context
+     * @details Turns every color byte into 8 RMT symbols through the type specific symbol table
+     * applying gamma, brightness and dithering on the fly, then appends the reset code
+     * @param data Colors to encode
+     * @param dataSize Size of data in bytes
+     * @param symbolsWritten Symbols already encoded in this transaction
+     * @param symbolsFree Space left in RMT memory
+     * @param symbols RMT memory to fill
+     * @param done Set when transaction is fully encoded
+     * @param arg Segment being transmitted
+     * @return size_t Number of symbols encoded, 0 if there is not enough space
      */
-    static size_t encode_led_strip(rmt_encoder_t* encoder, rmt_channel_handle_t channel, 
-                                 const void* primary_data, size_t data_size, 
-                                 rmt_encode_state_t* ret_state);
+    static size_t encode_led_strip(const void* data, size_t dataSize,
+                                   size_t symbolsWritten, size_t symbolsFree,
+                                   rmt_symbol_word_t* symbols, bool* done, void* arg);
 
     /**
-     * @brief Delete RMT encoder
-     * @param encoder Encoder to delete
-     * @return esp_err_t ESP_OK on success
+     * @brief RMT transaction done callback, runs in RMT ISR context
+     * @details Releases the output frame once its last segment is done
+     * @param arg Segment which finished transaction
+     * @return bool Whether a higher priority task was woken
      */
-    static esp_err_t delete_encoder(rmt_encoder_t* encoder);
+    static bool on_segment_done(rmt_channel_handle_t channel, const rmt_tx_done_event_data_t* event, void* arg);
 
     /**
-     * @brief Reset RMT encoder
-     * @param encoder Encoder to reset
-     * @return esp_err_t ESP_OK on success
+     * @brief Create and enable RMT channels, encoders and output frames of every segment
      */
-    static esp_err_t reset_encoder(rmt_encoder_t* encoder);
+    esp_err_t initRmt(const std::size_t ledCount, const Rating rating);
 
-    rmt_encoder_handle_t ledEncoder_ = nullptr;  ///< RMT encoder handle
-    rmt_channel_handle_t ledChannel_ = nullptr;  ///< RMT channel handle
+    /**
+     * @brief Get an output frame not owned by RMT
+     * @details In BLOCKING mode waits for all frames to be transmitted, in ASYNC mode for any of them
+     * @return frame_t* Free frame or nullptr on timeout
+     */
+    frame_t* acquireFrame(void);
+
+    /**
+     * @brief Submit frame to every segment channel
+     */
+    esp_err_t transmitFrame(frame_t& frame);
+
+    esp_err_t initError_ = ESP_OK;                    ///< Result of RMT setup in the constructor
+    rmt_sync_manager_handle_t syncManager_ = nullptr; ///< Starts segments together, if supported
+    std::array<frame_t, OutputFrames> frames_;        ///< Output frames, queued or on the wire
+    SemaphoreHandle_t frameDone_ = nullptr;           ///< Given from ISR whenever a frame gets free
+#else
+    std::vector<uint8_t> wire_;  ///< Output bytes of the last frame
+    FrameSink frameSink_;        ///< Host side consumer of frames
+#endif
+    std::vector<segment_t> segments_; ///< Parallel data lines, never resized after construction
     std::vector<typename LedTypeSpecific<Type>::ColorFormat> leds_; ///< LED color buffer
+    OutputLut outputLut_;      ///< Table of the next frame, frames on the wire keep their own copy
     uint8_t brightness_ = 255; ///< Current brightness level (0-255)
+    float gamma_ = 1.0f;       ///< Gamma correction exponent
+    bool dithering_ = false;   ///< Temporal dithering enabled
+    bool ditherActive_ = false; ///< Current content has channels with fractional output to dither
+    uint32_t ditherGeneration_ = 0; ///< Content generation ditherActive_ was decided for
+    std::bitset<256> fractionalLevels_; ///< Channel values with fractional output level
+    uint8_t ditherPhase_ = 0;  ///< Dithering step of the last submitted frame
+    uint32_t lutVersion_ = 0;  ///< Incremented on every output table rebuild
+    uint32_t generation_ = 1;     ///< Incremented on every content change
+    uint32_t sentGeneration_ = 0; ///< Generation of the last transmitted frame
+    uint32_t sentHash_ = 0;       ///< Content hash of the last transmitted frame
+    int64_t sentTimeUs_ = 0;      ///< Time of the last transmission
+    uint32_t refreshIntervalMs_ = 0; ///< Forced refresh interval, 0 if disabled
+    UpdateMode mode_ = UpdateMode::BLOCKING; ///< Frame submission mode
+    FrameDoneCallback frameDoneCallback_ = nullptr; ///< Frame completion notification
+    void* frameDoneArg_ = nullptr;   ///< Argument of frame completion notification
 };
 
 
 /* ================== Implementation of template methods =================== */
 
 template<LedType Type>
-AddresableLED<Type>::AddresableLED(const std::size_t ledCount, const gpio_num_t connPin, const Rating rating) {
+AddresableLED<Type>::AddresableLED(const std::size_t ledCount, const gpio_num_t connPin, const Rating rating)
+    : AddresableLED(ledCount, std::vector<gpio_num_t>{connPin}, rating) {
+}
+
+template<LedType Type>
+AddresableLED<Type>::AddresableLED(const std::size_t ledCount, const std::vector<gpio_num_t>& connPins, const Rating rating) {
+    assert(!connPins.empty() && connPins.size() <= ledCount);
+
+    /* Leftover LEDs go one by one to the first segments*/
+    segments_.resize(connPins.size());
+    size_t start = 0;
+    for (size_t i = 0; i < segments_.size(); i++) {
+        segments_[i] = {};
+        segments_[i].start = start;
+        segments_[i].count = ledCount / connPins.size() + ((i < ledCount % connPins.size()) ? 1 : 0);
+        segments_[i].pin = connPins[i];
+        start += segments_[i].count;
+    }
+
+#if CONFIG_IDF_TARGET_LINUX
+    (void)rating;
+    wire_.resize(ledCount * sizeof(typename LedTypeSpecific<Type>::ColorFormat));
+    ESP_LOGI(addressable_led::TAG, "host strip of %zu leds in %zu segments (pins unused)", ledCount, segments_.size());
+#else
+    initError_ = initRmt(ledCount, rating);
+    if (initError_ != ESP_OK) {
+        ESP_LOGE(addressable_led::TAG, "RMT setup failed: %s", esp_err_to_name(initError_));
+    }
+#endif
+
+    leds_.resize(ledCount);
+    leds_.shrink_to_fit();
+
+    /* Set full brightness */
+    setBrightness(255);
+    clear();
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+template<LedType Type>
+esp_err_t AddresableLED<Type>::initRmt(const std::size_t ledCount, const Rating rating) {
     size_t rmtMemoryBlockSize;
     size_t rmtTransactionQueueDepth;
-    const uint32_t rmtResolutionHz = 10'000'000; // makes uS resolution which is sufficient for WS2812B
     switch (rating) {
         case Rating::PERFOMANCE:
             rmtMemoryBlockSize = 128;
@@ -193,43 +630,137 @@ AddresableLED<Type>::AddresableLED(const std::size_t ledCount, const gpio_num_t
             rmtTransactionQueueDepth = 4;
             ESP_LOGW(addressable_led::TAG, "unknown rmt rating, using DEFAULT settings");
     }
-    
-    const rmt_tx_channel_config_t rmtTxChConfig = {
-        .gpio_num = connPin,
-        .clk_src = RMT_CLK_SRC_DEFAULT,
-        /* Increase the block size can make the LED less flickering*/
-        .resolution_hz = rmtResolutionHz,
-        .mem_block_symbols = rmtMemoryBlockSize,
-        /* Set the number of transactions that can be pending in the background*/
-        .trans_queue_depth = rmtTransactionQueueDepth,
-        .intr_priority = 0,
-        .flags = {},
-    };
 
-    ESP_ERROR_CHECK(rmt_new_tx_channel(&rmtTxChConfig, &ledChannel_));
-    ESP_LOGI(addressable_led::TAG, "create RMT TX channel");
+    std::vector<rmt_channel_handle_t> channels;
+    for (auto& segment : segments_) {
+        const rmt_tx_channel_config_t rmtTxChConfig = {
+            .gpio_num = segment.pin,
+            .clk_src = RMT_CLK_SRC_DEFAULT,
+            /* Increase the block size can make the LED less flickering*/
+            .resolution_hz = addressable_led::RmtResolutionHz,
+            .mem_block_symbols = rmtMemoryBlockSize,
+            /* Set the number of transactions that can be pending in the background*/
+            .trans_queue_depth = rmtTransactionQueueDepth,
+            .intr_priority = 0,
+            .flags = {},
+        };
 
-    RmtLedStripEncoder* led_encoder = static_cast<RmtLedStripEncoder*>(rmt_alloc_encoder_mem(sizeof(RmtLedStripEncoder)));
-    ESP_ERROR_CHECK(create_encoder(led_encoder, rmtResolutionHz));
-    ledEncoder_ = &led_encoder->base;
-    ESP_LOGI(addressable_led::TAG, "install led strip encoder");
+        ESP_RETURN_ON_ERROR(rmt_new_tx_channel(&rmtTxChConfig, &segment.channel), addressable_led::TAG, "unable to create RMT channel on gpio %d", segment.pin);
+        ESP_LOGI(addressable_led::TAG, "create RMT TX channel on gpio %d for %zu leds", segment.pin, segment.count);
 
-    ESP_ERROR_CHECK(rmt_enable(ledChannel_));
-    ESP_LOGI(addressable_led::TAG, "enable RMT TX channel");
+        segment.owner = this;
+        const rmt_simple_encoder_config_t encoderConfig = {
+            .callback = &AddresableLED<Type>::encode_led_strip,
+            .arg = &segment,
+            .min_chunk_size = addressable_led::SymbolsPerByte,
+        };
+        ESP_RETURN_ON_ERROR(rmt_new_simple_encoder(&encoderConfig, &segment.encoder), addressable_led::TAG, "unable to create encoder");
 
-    leds_.resize(ledCount);
-    leds_.shrink_to_fit();
+        const rmt_tx_event_callbacks_t callbacks = {
+            .on_trans_done = &AddresableLED<Type>::on_segment_done,
+        };
+        ESP_RETURN_ON_ERROR(rmt_tx_register_event_callbacks(segment.channel, &callbacks, &segment), addressable_led::TAG, "unable to register RMT callbacks");
+        channels.push_back(segment.channel);
+    }
+    ESP_LOGI(addressable_led::TAG, "install led strip encoders");
 
-    /* Set full brightness */
-    setBrightness(255);
-    clear();
+    frameDone_ = xSemaphoreCreateBinary();
+    ESP_RETURN_ON_FALSE(frameDone_, ESP_ERR_NO_MEM, addressable_led::TAG, "unable to create frame semaphore");
+    for (auto& frame : frames_) {
+        frame.leds.resize(ledCount);
+        frame.leds.shrink_to_fit();
+        frame.lutVersion = 0;
+        frame.ditherPhase = 0;
+        frame.pendingSegments.store(0);
+    }
+
+#if SOC_RMT_SUPPORT_TX_SYNCHRO
+    if (channels.size() > 1) {
+        const rmt_sync_manager_config_t syncConfig = {
+            .tx_channel_array = channels.data(),
+            .array_size = channels.size(),
+        };
+        ESP_RETURN_ON_ERROR(rmt_new_sync_manager(&syncConfig, &syncManager_), addressable_led::TAG, "unable to create sync manager");
+        ESP_LOGI(addressable_led::TAG, "segments are started by sync manager");
+    }
+#else
+    if (channels.size() > 1) {
+        ESP_LOGI(addressable_led::TAG, "no RMT sync manager on this chip, segments are started back to back");
+    }
+#endif
+
+    for (auto& segment : segments_) {
+        ESP_RETURN_ON_ERROR(rmt_enable(segment.channel), addressable_led::TAG, "unable to enable RMT channel");
+        segment.enabled = true;
+    }
+    ESP_LOGI(addressable_led::TAG, "enable RMT TX channels");
+    return ESP_OK;
+}
+#endif
+
+template<LedType Type>
+AddresableLED<Type>::~AddresableLED() {
+#if !CONFIG_IDF_TARGET_LINUX
+    for (const auto& segment : segments_) {
+        if (segment.enabled) {
+            rmt_tx_wait_all_done(segment.channel, pdMS_TO_TICKS(1000));
+        }
+    }
+    if (frameDone_ != nullptr) {
+        vSemaphoreDelete(frameDone_);
+    }
+    if (syncManager_ != nullptr) {
+        rmt_del_sync_manager(syncManager_);
+    }
+    /* Constructor may have failed half way*/
+    for (const auto& segment : segments_) {
+        if (segment.enabled) {
+            rmt_disable(segment.channel);
+        }
+        if (segment.channel != nullptr) {
+            rmt_del_channel(segment.channel);
+        }
+        if (segment.encoder != nullptr) {
+            rmt_del_encoder(segment.encoder);
+        }
+    }
+#endif
 }
 
 template<LedType Type>
 void AddresableLED<Type>::setBrightness(uint8_t level)  {
     brightness_ = level;
-    applyBrightness();
-    ESP_LOGI(addressable_led::TAG, "brightness set to %d [0 .. 255]", brightness_);
+    rebuildOutputLut();
+    ESP_LOGD(addressable_led::TAG, "brightness set to %d [0 .. 255]", brightness_);
+}
+
+template<LedType Type>
+void AddresableLED<Type>::setGamma(float gamma) {
+    gamma_ = (gamma > 0.0f) ? gamma : 1.0f;
+    rebuildOutputLut();
+}
+
+template<LedType Type>
+void AddresableLED<Type>::setDithering(bool enable) {
+    dithering_ = enable;
+    rebuildOutputLut();
+}
+
+template<LedType Type>
+void AddresableLED<Type>::rebuildOutputLut(void) {
+    /* Max output 255.0 in 8.8 fixed point, so dithering offset never overflows a byte*/
+    const float Scale = brightness_ * 256.0f;
+    for (size_t i = 0; i < outputLut_.size(); i++) {
+        const float Linear = (gamma_ == 1.0f) ? (i / 255.0f) : std::pow(i / 255.0f, gamma_);
+        uint16_t value = static_cast<uint16_t>(Linear * Scale + 0.5f);
+        if (!dithering_) {
+            value = ((value + 128) >> 8) << 8; //< round to whole output level
+        }
+        fractionalLevels_[i] = (value & 0xFF) != 0;
+        outputLut_[i] = value;
+    }
+    lutVersion_++;
+    generation_++;
 }
 
 template<LedType Type>
@@ -239,165 +770,295 @@ esp_err_t AddresableLED<Type>::setColor(const color::CRGB& color, size_t ledInde
         return ESP_ERR_INVALID_SIZE;
     }
 
-    leds_[ledIndex] = color.toColor<typename LedTypeSpecific<Type>::ColorFormat>();
-    applyBrightness();
+    const auto LedColor = color.toColor<typename LedTypeSpecific<Type>::ColorFormat>();
+    if (leds_[ledIndex] != LedColor) {
+        leds_[ledIndex] = LedColor;
+        generation_++;
+    }
 
     return ESP_OK;
 }
 
 template<LedType Type>
 esp_err_t AddresableLED<Type>::setColor(const color::CRGB& color, size_t startIndex, size_t count) {
-    if (startIndex + count >= leds_.size()) {
+    if (startIndex + count > leds_.size()) {
         return ESP_ERR_INVALID_SIZE;
     }
 
-    const size_t EndIndex = startIndex + count;
+    const auto LedColor = color.toColor<typename LedTypeSpecific<Type>::ColorFormat>();
+    color::fill(leds_.data() + startIndex, count, LedColor);
+    generation_++;
+
+    return ESP_OK;
+}
 
-    for (size_t i = startIndex; i < EndIndex; i++) {
-        leds_[i] = color.toColor<typename LedTypeSpecific<Type>::ColorFormat>();
+template<LedType Type>
+esp_err_t AddresableLED<Type>::setColors(const color::CRGB* colors, size_t startIndex, size_t count) {
+    if (startIndex + count > leds_.size()) {
+        return ESP_ERR_INVALID_SIZE;
     }
-    applyBrightness();
+
+    /* Resolves to the SWAR kernel for GRB and to white extraction for RGBW formats*/
+    color::convert(colors, leds_.data() + startIndex, count);
+    generation_++;
 
     return ESP_OK;
 }
 
 template<LedType Type>
 void AddresableLED<Type>::clear(void) {
-    for (auto& led : leds_) {
-        led = LedTypeSpecific<Type>::ColorFormat::Black;
+    color::fill(leds_.data(), leds_.size(), LedTypeSpecific<Type>::ColorFormat::Black);
+    generation_++;
+}
+
+template<LedType Type>
+void AddresableLED<Type>::setRefreshInterval(uint32_t intervalMs) {
+    refreshIntervalMs_ = intervalMs;
+}
+
+template<LedType Type>
+uint32_t AddresableLED<Type>::contentHash(void) const {
+    /* FNV-1a over the raw colors, cheap compared to wire time of the same data*/
+    uint32_t hash = 2166136261u ^ lutVersion_;
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(leds_.data());
+    const size_t Size = leds_.size() * sizeof(leds_[0].raw);
+    for (size_t i = 0; i < Size; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+template<LedType Type>
+bool AddresableLED<Type>::contentNeedsDither(void) const {
+    if (fractionalLevels_.none()) {
+        return false;
+    }
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(leds_.data());
+    const size_t Size = leds_.size() * sizeof(leds_[0].raw);
+    for (size_t i = 0; i < Size; i++) {
+        if (fractionalLevels_[bytes[i]]) {
+            return true;
+        }
     }
+    return false;
 }
 
 template<LedType Type>
 esp_err_t AddresableLED<Type>::update(void) {
-    if (rmt_tx_wait_all_done(ledChannel_, pdMS_TO_TICKS(1000)) != ESP_OK) {
+    const int64_t NowUs = esp_timer_get_time();
+    /* Table rebuilds bump the generation too. Full on/off faces stay static and are skipped*/
+    if (ditherGeneration_ != generation_) {
+        ditherActive_ = contentNeedsDither();
+        ditherGeneration_ = generation_;
+    }
+    const bool RefreshDue = ditherActive_ ||
+        (refreshIntervalMs_ && (NowUs - sentTimeUs_ >= static_cast<int64_t>(refreshIntervalMs_) * 1000));
+
+    if (generation_ == sentGeneration_ && !RefreshDue) {
+        return ESP_OK;
+    }
+
+    /* Content could be rewritten with the very same colors*/
+    const uint32_t Hash = contentHash();
+    if (Hash == sentHash_ && sentGeneration_ != 0 && !RefreshDue) {
+        sentGeneration_ = generation_;
+        return ESP_OK;
+    }
+
+    TRACE_SCOPE("led.update");
+    ditherPhase_++;
+
+#if CONFIG_IDF_TARGET_LINUX
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(leds_.data());
+    for (size_t i = 0; i < wire_.size(); i++) {
+        wire_[i] = outputByte(bytes[i], i, ditherPhase_);
+    }
+    if (frameSink_) {
+        frameSink_(wire_.data(), wire_.size(), Hash != sentHash_ || sentGeneration_ == 0);
+    }
+    if (frameDoneCallback_) {
+        frameDoneCallback_(frameDoneArg_);
+    }
+#else
+    ESP_RETURN_ON_ERROR(initError_, addressable_led::TAG, "update: strip is not initialized");
+    const int64_t WaitStartUs = esp_timer_get_time();
+    frame_t* frame = acquireFrame();
+    addressable_led::RmtWaitUs.add(static_cast<uint32_t>(esp_timer_get_time() - WaitStartUs));
+    if (frame == nullptr) {
+        addressable_led::TransmitFailures.add();
         ESP_LOGI(addressable_led::TAG, "looks like rmt got stuck - rmt busy for too long");
         return ESP_ERR_TIMEOUT;
     }
 
-    const rmt_transmit_config_t txConfig = {
-        .loop_count = 0,
-        .flags = {},
-    };
+    /* Frame is not owned by RMT, so callers can keep drawing into leds_ meanwhile*/
+    std::copy(leds_.begin(), leds_.end(), frame->leds.begin());
+    if (frame->lutVersion != lutVersion_) {
+        frame->lut = outputLut_;
+        frame->lutVersion = lutVersion_;
+    }
+    frame->ditherPhase = ditherPhase_;
 
-    const uint8_t ColorsCount = 3;
-    if (rmt_transmit(ledChannel_, ledEncoder_, leds_.data(), leds_.size() * ColorsCount, &txConfig) != ESP_OK) {
+    if (transmitFrame(*frame) != ESP_OK) {
+        addressable_led::TransmitFailures.add();
         ESP_LOGI(addressable_led::TAG, "unable to update buffer");
         return ESP_FAIL;
     }
+#endif
+
+    addressable_led::FramesSent.add();
+    sentGeneration_ = generation_;
+    sentHash_ = Hash;
+    sentTimeUs_ = NowUs;
+    ESP_LOGD(addressable_led::TAG, "buffer updated");
 
-    ESP_LOGI(addressable_led::TAG, "buffer updated");
-    
     return ESP_OK;
 }
 
 template<LedType Type>
-void AddresableLED<Type>::applyBrightness(void) {
-    const uint16_t brightness__ = brightness_;
-    for (auto& led : leds_) {
-        led.r = (led.r * brightness__) / 255;
-        led.g = (led.g * brightness__) / 255;
-        led.b = (led.b * brightness__) / 255;
+esp_err_t AddresableLED<Type>::waitDone(uint32_t timeoutMs) {
+#if !CONFIG_IDF_TARGET_LINUX
+    ESP_RETURN_ON_ERROR(initError_, addressable_led::TAG, "waitDone: strip is not initialized");
+    for (const auto& segment : segments_) {
+        ESP_RETURN_ON_ERROR(rmt_tx_wait_all_done(segment.channel, timeoutMs), addressable_led::TAG, "waitDone: timeout");
     }
+#endif
+    return ESP_OK;
 }
 
+#if !CONFIG_IDF_TARGET_LINUX
 template<LedType Type>
-esp_err_t AddresableLED<Type>::create_encoder(RmtLedStripEncoder* encoder, uint32_t resolutionHz) {  
-    encoder->base.encode = &AddresableLED<Type>::encode_led_strip;
-    encoder->base.del = &AddresableLED<Type>::delete_encoder;
-    encoder->base.reset = &AddresableLED<Type>::reset_encoder;
-    
-    const uint32_t UsInSec = 1'000'000;
-    const uint16_t TicksPerUs = resolutionHz / UsInSec;
-    // Configure based on LED type traits
-    rmt_bytes_encoder_config_t bytes_encoder_config = {
-        .bit0 = {
-            .duration0 = static_cast<uint16_t>(LedTypeSpecific<Type>::T0H_us * TicksPerUs),
-            .level0 = 1,
-            .duration1 = static_cast<uint16_t>(LedTypeSpecific<Type>::T0L_us * TicksPerUs),
-            .level1 = 0,
-        },
-        .bit1 = {
-            .duration0 = static_cast<uint16_t>(LedTypeSpecific<Type>::T1H_us * TicksPerUs),
-            .level0 = 1,
-            .duration1 = static_cast<uint16_t>(LedTypeSpecific<Type>::T1L_us * TicksPerUs),
-            .level1 = 0,
-        },
-        .flags = {
-            .msb_first = LedTypeSpecific<Type>::msbFirst,
+typename AddresableLED<Type>::frame_t* AddresableLED<Type>::acquireFrame(void) {
+    while (true) {
+        frame_t* freeFrame = nullptr;
+        bool allFree = true;
+        for (auto& frame : frames_) {
+            if (frame.pendingSegments.load() != 0) {
+                allFree = false;
+            } else if (freeFrame == nullptr) {
+                freeFrame = &frame;
+            }
         }
-    };
+        if (freeFrame != nullptr && (mode_ == UpdateMode::ASYNC || allFree)) {
+            return freeFrame;
+        }
+
+        /* State is checked before waiting, so a frame released meanwhile leaves the semaphore given*/
+        TRACE_SCOPE("led.wait_frame");
+        if (xSemaphoreTake(frameDone_, pdMS_TO_TICKS(1000)) != pdTRUE) {
+            return nullptr;
+        }
+    }
+}
 
-    rmt_copy_encoder_config_t copy_encoder_config = {};
-    
-    ESP_RETURN_ON_ERROR(rmt_new_bytes_encoder(&bytes_encoder_config, &encoder->bytes_encoder), 
-                       addressable_led::TAG, "create bytes encoder failed");
-    ESP_RETURN_ON_ERROR(rmt_new_copy_encoder(&copy_encoder_config, &encoder->copy_encoder), 
-                       addressable_led::TAG, "create copy encoder failed");
-    
-    const uint16_t TickForReset = TicksPerUs * 50 / 2; // 50us reset code
-    encoder->reset_code = {
-        .duration0 = TickForReset,
-        .level0 = 0,
-        .duration1 = TickForReset,
-        .level1 = 0
+template<LedType Type>
+esp_err_t AddresableLED<Type>::transmitFrame(frame_t& frame) {
+    const rmt_transmit_config_t txConfig = {
+        .loop_count = 0,
+        .flags = {},
     };
-    
+
+    bool idle = true;
+    for (const auto& other : frames_) {
+        idle &= other.pendingSegments.load() == 0;
+    }
+
+    /* Sync manager holds channels until every one of them got its transaction. It is only rearmed
+     * on idle channels, frames queued behind a running one start as soon as equal segments finish*/
+    if (syncManager_ != nullptr && idle) {
+        ESP_RETURN_ON_ERROR(rmt_sync_reset(syncManager_), addressable_led::TAG, "unable to rearm sync manager");
+    }
+
+    const uint8_t FrameIndex = static_cast<uint8_t>(&frame - frames_.data());
+    const size_t ColorsCount = sizeof(typename LedTypeSpecific<Type>::ColorFormat);
+    frame.pendingSegments.store(segments_.size());
+    for (size_t i = 0; i < segments_.size(); i++) {
+        segment_t& segment = segments_[i];
+        segment.inFlight[segment.tail % OutputFrames] = FrameIndex;
+        segment.tail++;
+
+        if (rmt_transmit(segment.channel, segment.encoder, frame.leds.data() + segment.start,
+                         segment.count * ColorsCount, &txConfig) != ESP_OK) {
+            /* Segments which did not get the frame will never report it*/
+            segment.tail--;
+            frame.pendingSegments.fetch_sub(segments_.size() - i);
+            return ESP_FAIL;
+        }
+    }
     return ESP_OK;
 }
 
 template<LedType Type>
-size_t AddresableLED<Type>::encode_led_strip(rmt_encoder_t* encoder, rmt_channel_handle_t channel, const void* primary_data, size_t data_size, rmt_encode_state_t* ret_state) {
-    RmtLedStripEncoder* led_encoder = reinterpret_cast<RmtLedStripEncoder*>(encoder);
-    size_t encoded_symbols = 0;
-    rmt_encode_state_t session_state = RMT_ENCODING_RESET;
-    rmt_encode_state_t state = RMT_ENCODING_RESET;
-    
-    switch (led_encoder->state) {
-    case 0: // send RGB data
-        encoded_symbols += led_encoder->bytes_encoder->encode(led_encoder->bytes_encoder, channel, 
-                                                            primary_data, data_size, &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE) {
-            led_encoder->state = 1;
-        }
-        if (session_state & RMT_ENCODING_MEM_FULL) {
-            state = static_cast<rmt_encode_state_t>(state | RMT_ENCODING_MEM_FULL);
-            goto out;
-        }
-        // fall-through
-    case 1: // send reset code
-        encoded_symbols += led_encoder->copy_encoder->encode(led_encoder->copy_encoder, channel,
-                                                           &led_encoder->reset_code,
-                                                           sizeof(led_encoder->reset_code),
-                                                           &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE) {
-            led_encoder->state = RMT_ENCODING_RESET;
-            state = static_cast<rmt_encode_state_t>(state | RMT_ENCODING_COMPLETE);
-        }
-        if (session_state & RMT_ENCODING_MEM_FULL) {
-            state = static_cast<rmt_encode_state_t>(state | RMT_ENCODING_MEM_FULL);
-            goto out;
-        }
+bool AddresableLED<Type>::on_segment_done(rmt_channel_handle_t channel, const rmt_tx_done_event_data_t* event, void* arg) {
+    segment_t* segment = static_cast<segment_t*>(arg);
+    AddresableLED<Type>* self = segment->owner;
+
+    frame_t& frame = self->frames_[segment->inFlight[segment->head % OutputFrames]];
+    segment->head++;
+    if (frame.pendingSegments.fetch_sub(1) != 1) {
+        return false;
     }
-out:
-    *ret_state = state;
-    return encoded_symbols;
+    TRACE_INSTANT("led.frame_done");
+
+    if (self->frameDoneCallback_) {
+        self->frameDoneCallback_(self->frameDoneArg_);
+    }
+    BaseType_t taskWoken = pdFALSE;
+    xSemaphoreGiveFromISR(self->frameDone_, &taskWoken);
+    return taskWoken == pdTRUE;
 }
+#endif
 
 template<LedType Type>
-esp_err_t AddresableLED<Type>::delete_encoder(rmt_encoder_t* encoder) {
-    RmtLedStripEncoder* led_encoder = reinterpret_cast<RmtLedStripEncoder*>(encoder);
-    rmt_del_encoder(led_encoder->bytes_encoder);
-    rmt_del_encoder(led_encoder->copy_encoder);
-    free(led_encoder);
-    return ESP_OK;
+void AddresableLED<Type>::encodeSymbols(const OutputLut& lut, const uint8_t* bytes, size_t index, size_t count,
+                                        uint32_t* symbols, uint8_t ditherPhase) {
+    for (size_t i = 0; i < count; i++) {
+        const auto& Bits = addressable_led::SymbolTableFor<Type>[outputByte(lut, bytes[i], index + i, ditherPhase)];
+        for (size_t bit = 0; bit < addressable_led::SymbolsPerByte; bit++) {
+            *symbols++ = Bits[bit];
+        }
+    }
 }
 
+#if !CONFIG_IDF_TARGET_LINUX
 template<LedType Type>
-esp_err_t AddresableLED<Type>::reset_encoder(rmt_encoder_t* encoder) {
-    RmtLedStripEncoder* led_encoder = reinterpret_cast<RmtLedStripEncoder*>(encoder);
-    rmt_encoder_reset(led_encoder->bytes_encoder);
-    rmt_encoder_reset(led_encoder->copy_encoder);
-    led_encoder->state = RMT_ENCODING_RESET;
-    return ESP_OK;
-}
\ No newline at end of file
+size_t AddresableLED<Type>::encode_led_strip(const void* data, size_t dataSize,
+                                             size_t symbolsWritten, size_t symbolsFree,
+                                             rmt_symbol_word_t* symbols, bool* done, void* arg) {
+    static_assert(sizeof(rmt_symbol_word_t) == sizeof(uint32_t), "symbol is expected to be a raw 32-bit word");
+
+    const segment_t* segment = static_cast<const segment_t*>(arg);
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    const size_t Position = symbolsWritten / addressable_led::SymbolsPerByte;
+    /* Dithering step follows position in the whole frame, not in the segment*/
+    const size_t FrameOffset = segment->start * sizeof(typename LedTypeSpecific<Type>::ColorFormat);
+
+    /* Frame owning the data keeps the output table and dithering step it was submitted with*/
+    const OutputLut* lut = &segment->owner->outputLut_;
+    uint8_t ditherPhase = 0;
+    for (const auto& frame : segment->owner->frames_) {
+        if (bytes >= reinterpret_cast<const uint8_t*>(frame.leds.data()) &&
+            bytes < reinterpret_cast<const uint8_t*>(frame.leds.data() + frame.leds.size())) {
+            lut = &frame.lut;
+            ditherPhase = frame.ditherPhase;
+            break;
+        }
+    }
+
+    if (Position >= dataSize) {
+        if (symbolsFree < 1) {
+            return 0;
+        }
+        symbols[0].val = addressable_led::ResetSymbolFor<Type>;
+        *done = true;
+        return 1;
+    }
+
+    /* Fill as many whole bytes as RMT memory block fits*/
+    const size_t BytesCount = std::min(symbolsFree / addressable_led::SymbolsPerByte, dataSize - Position);
+    encodeSymbols(*lut, bytes + Position, FrameOffset + Position, BytesCount,
+                  reinterpret_cast<uint32_t*>(symbols), ditherPhase);
+
+    *done = false;
+    return BytesCount * addressable_led::SymbolsPerByte;
+}
+#endif
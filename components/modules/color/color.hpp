@@ -1,6 +1,9 @@
 #pragma once
 #include <cstdint>
+#include <cstddef>
+#include <cstring>
 #include <array>
+#include <algorithm>
 
 namespace color {
 
@@ -14,35 +17,125 @@ namespace color {
             uint8_t raw[3];
         };  
 
-        CRGB(uint8_t red = 0, uint8_t green = 0, uint8_t blue = 0)
+        constexpr CRGB(uint8_t red = 0, uint8_t green = 0, uint8_t blue = 0)
             : r(red), g(green), b(blue) {};
 
         template<typename TargetFormat>
         TargetFormat toColor() const;
 
+        bool operator==(const CRGB& other) const {
+            return r == other.r && g == other.g && b == other.b;
+        }
+        bool operator!=(const CRGB& other) const {
+            return !(*this == other);
+        }
+
         /* Predefined static color constants*/
         static const CRGB Black, Red, Green, Blue, White;
     };
 
-    struct CGRB {
-        union { 
-            struct {
-                uint8_t g;
-                uint8_t r;
-                uint8_t b;
-            };
-            uint8_t raw[3];
-        };  
+    /**
+     * @brief Channel of a pixel format
+     */
+    enum class Channel : uint8_t {
+        R,
+        G,
+        B,
+        W, ///< Dedicated white LED of RGBW parts
+    };
+
+    /**
+     * @struct Format
+     * @brief Packed pixel with compile-time channel order and width
+     * @tparam Order Channels in memory (and wire) order
+     * @details Formats with a white channel take the common part of red, green and blue as white
+     * when converted from CRGB, see extractWhite()
+     */
+    template<Channel... Order>
+    struct Format {
+        static constexpr std::size_t Width = sizeof...(Order);
+        static constexpr std::array<Channel, Width> ChannelOrder = {Order...};
+        static constexpr bool HasWhite = ((Order == Channel::W) || ...);
+
+        static_assert(Width >= 3 && Width <= 4, "pixel formats are RGB or RGBW");
+
+        uint8_t raw[Width];
+
+        constexpr Format() : raw{} {}
 
-        CGRB(uint8_t green = 0, uint8_t red = 0, uint8_t blue = 0)
-            : g(green), r(red), b(blue) {};
+        constexpr Format(uint8_t red, uint8_t green, uint8_t blue, uint8_t white = 0)
+            : raw{pick(Order, red, green, blue, white)...} {}
 
-        CRGB toRGB(void) const;
+        /**
+         * @brief Convert from CRGB, white is extracted for RGBW formats
+         */
+        static constexpr Format fromRGB(const CRGB& color) {
+            if constexpr (HasWhite) {
+                const uint8_t White = std::min(color.r, std::min(color.g, color.b));
+                return Format(color.r - White, color.g - White, color.b - White, White);
+            } else {
+                return Format(color.r, color.g, color.b);
+            }
+        }
+
+        constexpr uint8_t get(Channel channel) const {
+            for (std::size_t i = 0; i < Width; i++) {
+                if (ChannelOrder[i] == channel) {
+                    return raw[i];
+                }
+            }
+            return 0;
+        }
+
+        /**
+         * @brief Convert to CRGB, white is added back to every color channel
+         */
+        CRGB toRGB(void) const {
+            const uint8_t White = get(Channel::W);
+            const auto Add = [White](uint8_t value) -> uint8_t {
+                return (value + White > 0xFF) ? 0xFF : value + White;
+            };
+            return CRGB(Add(get(Channel::R)), Add(get(Channel::G)), Add(get(Channel::B)));
+        }
+
+        bool operator==(const Format& other) const {
+            return std::memcmp(raw, other.raw, Width) == 0;
+        }
+        bool operator!=(const Format& other) const {
+            return !(*this == other);
+        }
 
         /* Predefined static color constants*/
-        static const CGRB Black, Red, Green, Blue, White;
+        static const Format Black, Red, Green, Blue, White;
+
+    private:
+        static constexpr uint8_t pick(Channel channel, uint8_t red, uint8_t green, uint8_t blue, uint8_t white) {
+            return (channel == Channel::R) ? red :
+                   (channel == Channel::G) ? green :
+                   (channel == Channel::B) ? blue : white;
+        }
     };
 
+    template<Channel... Order>
+    inline const Format<Order...> Format<Order...>::Black = Format(0, 0, 0);
+    template<Channel... Order>
+    inline const Format<Order...> Format<Order...>::Red   = Format(255, 0, 0);
+    template<Channel... Order>
+    inline const Format<Order...> Format<Order...>::Green = Format(0, 255, 0);
+    template<Channel... Order>
+    inline const Format<Order...> Format<Order...>::Blue  = Format(0, 0, 255);
+    template<Channel... Order>
+    inline const Format<Order...> Format<Order...>::White = Format::fromRGB(CRGB(255, 255, 255));
+
+    using CGRB = Format<Channel::G, Channel::R, Channel::B>;                 ///< WS2812B, WS2815
+    using CRGBOrder = Format<Channel::R, Channel::G, Channel::B>;            ///< WS2811, same layout as CRGB
+    using CGRBW = Format<Channel::G, Channel::R, Channel::B, Channel::W>;    ///< SK6812 RGBW
+
+    template<typename TargetFormat>
+    inline TargetFormat CRGB::toColor() const {
+        return TargetFormat::fromRGB(*this);
+    }
+
     /* Color constants*/
     inline const CRGB CRGB::Black = CRGB(0, 0, 0);
     inline const CRGB CRGB::Red   = CRGB(255, 0, 0);
@@ -50,18 +143,234 @@ namespace color {
     inline const CRGB CRGB::Blue  = CRGB(0, 0, 255);
     inline const CRGB CRGB::White = CRGB(255, 255, 255);
 
-    inline const CGRB CGRB::Black = CGRB(0, 0, 0);
-    inline const CGRB CGRB::Red   = CGRB(0, 255, 0);
-    inline const CGRB CGRB::Green = CGRB(255, 0, 0);
-    inline const CGRB CGRB::Blue  = CGRB(0, 0, 255);
-    inline const CGRB CGRB::White = CGRB(255, 255, 255);
+    /**
+     * Batch kernels over contiguous pixel spans.
+     *
+     * Pixels are treated as plain bytes and processed four channels per 32-bit word (SWAR),
+     * two 16-bit lanes per multiplication. Word path is taken when all spans are 4-byte aligned,
+     * the scalar versions in reference handle unaligned spans and the tail. Host tests in
+     * components/modules/test_apps check the word path against reference byte for byte.
+     *
+     * Brightness/blend weights are Q8: 0 means nothing, 256 means full.
+     */
+    namespace reference {
+
+        template<typename Pixel>
+        inline void fill(Pixel* dst, std::size_t count, const Pixel& value) {
+            for (std::size_t i = 0; i < count; i++) {
+                dst[i] = value;
+            }
+        }
+
+        inline void scale(uint8_t* bytes, std::size_t size, uint16_t level) {
+            for (std::size_t i = 0; i < size; i++) {
+                bytes[i] = (bytes[i] * level) >> 8;
+            }
+        }
+
+        inline void lerp(const uint8_t* a, const uint8_t* b, uint8_t* out, std::size_t size, uint16_t alpha) {
+            const uint16_t InvAlpha = 256 - alpha;
+            for (std::size_t i = 0; i < size; i++) {
+                out[i] = (a[i] * InvAlpha + b[i] * alpha) >> 8;
+            }
+        }
+
+        inline void addSaturate(uint8_t* dst, const uint8_t* src, std::size_t size) {
+            for (std::size_t i = 0; i < size; i++) {
+                const uint16_t Sum = dst[i] + src[i];
+                dst[i] = (Sum > 0xFF) ? 0xFF : Sum;
+            }
+        }
 
-    inline CRGB CGRB::toRGB(void) const {
-        return CRGB{r, g, b};
+        template<typename Pixel>
+        inline void convert(const CRGB* src, Pixel* dst, std::size_t count) {
+            for (std::size_t i = 0; i < count; i++) {
+                dst[i] = src[i].toColor<Pixel>();
+            }
+        }
     }
 
-    template<>
-    inline CGRB CRGB::toColor<CGRB>() const {
-        return CGRB(g, r, b);
+    namespace swar {
+        static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "SWAR kernels assume little endian words");
+
+        constexpr uint32_t LaneMask = 0x00FF00FF;
+
+        inline bool isAligned(const void* ptr) {
+            return (reinterpret_cast<uintptr_t>(ptr) & 3) == 0;
+        }
+
+        inline uint32_t load(const uint8_t* ptr) {
+            uint32_t word;
+            std::memcpy(&word, __builtin_assume_aligned(ptr, 4), sizeof(word));
+            return word;
+        }
+
+        inline void store(uint8_t* ptr, uint32_t word) {
+            std::memcpy(__builtin_assume_aligned(ptr, 4), &word, sizeof(word));
+        }
+
+        inline uint32_t scale(uint32_t word, uint32_t level) {
+            const uint32_t Even = (((word & LaneMask) * level) >> 8) & LaneMask;
+            const uint32_t Odd = (((word >> 8) & LaneMask) * level) & ~LaneMask;
+            return Even | Odd;
+        }
+
+        inline uint32_t lerp(uint32_t a, uint32_t b, uint32_t alpha) {
+            const uint32_t InvAlpha = 256 - alpha;
+            const uint32_t Even = (((a & LaneMask) * InvAlpha + (b & LaneMask) * alpha) >> 8) & LaneMask;
+            const uint32_t Odd = (((a >> 8) & LaneMask) * InvAlpha + ((b >> 8) & LaneMask) * alpha) & ~LaneMask;
+            return Even | Odd;
+        }
+
+        inline uint32_t addSaturate(uint32_t a, uint32_t b) {
+            const uint32_t Low = (a & 0x7F7F7F7F) + (b & 0x7F7F7F7F);
+            const uint32_t Sum = Low ^ ((a ^ b) & 0x80808080);
+            /* Carry out of every byte: majority of both top bits and carry into the top bit*/
+            const uint32_t Carry = ((a & b) | ((a ^ b) & Low)) & 0x80808080;
+            return Sum | ((Carry >> 7) * 0xFF);
+        }
+
+        /**
+         * @brief Swap first two channels of four packed 3-byte pixels (12 bytes, 3 words)
+         */
+        inline void swapRG(uint32_t& w0, uint32_t& w1, uint32_t& w2) {
+            const uint32_t In0 = w0, In1 = w1, In2 = w2;
+            w0 = ((In0 >> 8) & 0xFF) | ((In0 & 0xFF) << 8) | (In0 & 0x00FF0000) | (In1 << 24);
+            w1 = (In0 >> 24) | (In1 & 0x0000FF00) | ((In1 >> 8) & 0x00FF0000) | ((In1 << 8) & 0xFF000000);
+            w2 = (In2 & 0xFF0000FF) | ((In2 >> 8) & 0x0000FF00) | ((In2 << 8) & 0x00FF0000);
+        }
+    }
+
+    /**
+     * @brief Set count pixels to value
+     */
+    template<typename Pixel>
+    inline void fill(Pixel* dst, std::size_t count, const Pixel& value) {
+        /* Four pixels always make a whole number of words*/
+        constexpr std::size_t GroupWords = sizeof(Pixel);
+        if (!swar::isAligned(dst) || count < 4) {
+            reference::fill(dst, count, value);
+            return;
+        }
+
+        std::array<Pixel, 4> group;
+        reference::fill(group.data(), group.size(), value);
+        std::array<uint32_t, GroupWords> pattern;
+        std::memcpy(pattern.data(), group.data(), sizeof(group));
+
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(dst);
+        const std::size_t Groups = count / 4;
+        for (std::size_t g = 0; g < Groups; g++) {
+            for (std::size_t w = 0; w < GroupWords; w++) {
+                swar::store(bytes, pattern[w]);
+                bytes += sizeof(uint32_t);
+            }
+        }
+        reference::fill(dst + Groups * 4, count - Groups * 4, value);
+    }
+
+    /**
+     * @brief Scale every channel of count pixels by Q8 level
+     */
+    template<typename Pixel>
+    inline void scale(Pixel* pixels, std::size_t count, uint16_t level) {
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(pixels);
+        const std::size_t Size = count * sizeof(Pixel);
+        std::size_t i = 0;
+        if (swar::isAligned(bytes)) {
+            for (; i + 4 <= Size; i += 4) {
+                swar::store(bytes + i, swar::scale(swar::load(bytes + i), level));
+            }
+        }
+        reference::scale(bytes + i, Size - i, level);
+    }
+
+    /**
+     * @brief Blend count pixels, out = a * (256 - alpha) / 256 + b * alpha / 256
+     * @note out may alias a or b
+     */
+    template<typename Pixel>
+    inline void lerp(const Pixel* a, const Pixel* b, Pixel* out, std::size_t count, uint16_t alpha) {
+        const uint8_t* aBytes = reinterpret_cast<const uint8_t*>(a);
+        const uint8_t* bBytes = reinterpret_cast<const uint8_t*>(b);
+        uint8_t* outBytes = reinterpret_cast<uint8_t*>(out);
+        const std::size_t Size = count * sizeof(Pixel);
+        std::size_t i = 0;
+        if (swar::isAligned(aBytes) && swar::isAligned(bBytes) && swar::isAligned(outBytes)) {
+            for (; i + 4 <= Size; i += 4) {
+                swar::store(outBytes + i, swar::lerp(swar::load(aBytes + i), swar::load(bBytes + i), alpha));
+            }
+        }
+        reference::lerp(aBytes + i, bBytes + i, outBytes + i, Size - i, alpha);
+    }
+
+    /**
+     * @brief Add src to dst channel-wise, clamping at 255
+     */
+    template<typename Pixel>
+    inline void addSaturate(Pixel* dst, const Pixel* src, std::size_t count) {
+        uint8_t* dstBytes = reinterpret_cast<uint8_t*>(dst);
+        const uint8_t* srcBytes = reinterpret_cast<const uint8_t*>(src);
+        const std::size_t Size = count * sizeof(Pixel);
+        std::size_t i = 0;
+        if (swar::isAligned(dstBytes) && swar::isAligned(srcBytes)) {
+            for (; i + 4 <= Size; i += 4) {
+                swar::store(dstBytes + i, swar::addSaturate(swar::load(dstBytes + i), swar::load(srcBytes + i)));
+            }
+        }
+        reference::addSaturate(dstBytes + i, srcBytes + i, Size - i);
+    }
+
+    /**
+     * @brief Split RGB into RGBW, white takes min(r, g, b) and is removed from the color channels
+     * @details Branch free integer min, no division, so the white LED does the work at the
+     * same light output and the color LEDs only add the remaining tint
+     */
+    template<typename Pixel>
+    inline void extractWhite(const CRGB* src, Pixel* dst, std::size_t count) {
+        static_assert(Pixel::HasWhite, "white extraction needs RGBW format");
+
+        for (std::size_t i = 0; i < count; i++) {
+            const uint8_t R = src[i].r, G = src[i].g, B = src[i].b;
+            const uint8_t White = std::min(R, std::min(G, B));
+            dst[i] = Pixel(R - White, G - White, B - White, White);
+        }
+    }
+
+    /**
+     * @brief Convert count pixels from RGB to any pixel format
+     */
+    template<typename Pixel>
+    inline void convert(const CRGB* src, Pixel* dst, std::size_t count) {
+        if constexpr (Pixel::HasWhite) {
+            extractWhite(src, dst, count);
+        } else {
+            reference::convert(src, dst, count);
+        }
+    }
+
+    /**
+     * @brief Convert count pixels from RGB to GRB channel order
+     * @note src and dst may be the same buffer
+     */
+    inline void convert(const CRGB* src, CGRB* dst, std::size_t count) {
+        static_assert(sizeof(CRGB) == 3 && sizeof(CGRB) == 3, "packed 3-byte pixels expected");
+
+        const uint8_t* srcBytes = reinterpret_cast<const uint8_t*>(src);
+        uint8_t* dstBytes = reinterpret_cast<uint8_t*>(dst);
+        std::size_t i = 0;
+        if (swar::isAligned(srcBytes) && swar::isAligned(dstBytes)) {
+            for (; i + 4 <= count; i += 4) {
+                const std::size_t Offset = i * 3;
+                uint32_t w0 = swar::load(srcBytes + Offset);
+                uint32_t w1 = swar::load(srcBytes + Offset + 4);
+                uint32_t w2 = swar::load(srcBytes + Offset + 8);
+                swar::swapRG(w0, w1, w2);
+                swar::store(dstBytes + Offset, w0);
+                swar::store(dstBytes + Offset + 4, w1);
+                swar::store(dstBytes + Offset + 8, w2);
+            }
+        }
+        reference::convert(src + i, dst + i, count - i);
     }
-}
\ No newline at end of file
+}
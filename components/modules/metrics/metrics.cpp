@@ -0,0 +1,144 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <climits>
+#include <cstring>
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_console.h"
+#endif
+
+#define METRICS_LINE_LENGTH     (120)   //< summary log line, metrics are packed up to it
+#define METRICS_ENTRY_LENGTH    (96)
+
+static const char *TAG = "metrics";
+
+namespace {
+    std::atomic<metrics::Metric*> head {nullptr};
+
+    /**
+     * @brief Format single metric, returns length written
+     */
+    int formatMetric(const metrics::Metric& metric, char* buf, std::size_t size) {
+        switch (metric.getKind()) {
+            case metrics::Kind::COUNTER:
+                return snprintf(buf, size, "%s=%" PRIu32, metric.getName(),
+                                static_cast<const metrics::Counter&>(metric).get());
+            case metrics::Kind::GAUGE:
+                return snprintf(buf, size, "%s=%" PRId32, metric.getName(),
+                                static_cast<const metrics::Gauge&>(metric).get());
+            case metrics::Kind::HISTOGRAM: {
+                const auto& Histogram = static_cast<const metrics::Histogram&>(metric);
+                return snprintf(buf, size, "%s=%" PRIu32 "/%" PRIu32 "/%" PRIu32 "/%" PRIu32 "/%" PRIu32,
+                                metric.getName(), Histogram.getCount(), Histogram.getAverage(),
+                                Histogram.percentile(50), Histogram.percentile(99), Histogram.getMax());
+            }
+        }
+        return 0;
+    }
+
+#if !CONFIG_IDF_TARGET_LINUX
+    int metricsCommand(int argc, char **argv) {
+        metrics::print(stdout);
+        return 0;
+    }
+#endif
+}
+
+namespace metrics {
+
+    Metric::Metric(const char* name, Kind kind) : name_(name), kind_(kind) {
+        /* Usually runs from static constructors, but stays safe for metrics created later*/
+        Metric* expected = head.load();
+        do {
+            next_ = expected;
+        } while (!head.compare_exchange_weak(expected, this));
+    }
+
+    void Histogram::add(uint32_t value) {
+        const std::size_t Bucket = (value == 0) ? 0 :
+            std::min<std::size_t>(32 - __builtin_clz(value), Buckets - 1);
+
+        buckets_[Bucket].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+
+        uint32_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint32_t Histogram::bucketLimit(std::size_t bucket) {
+        return (bucket + 1 < Buckets) ? (uint32_t{1} << bucket) : UINT32_MAX;
+    }
+
+    uint32_t Histogram::percentile(uint32_t percent) const {
+        const uint64_t Needed = (static_cast<uint64_t>(getCount()) * percent + 99) / 100;
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < Buckets; i++) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen >= Needed && seen > 0) {
+                return std::min(bucketLimit(i), getMax());
+            }
+        }
+        return getMax();
+    }
+
+    uint32_t Histogram::getAverage(void) const {
+        const uint32_t Count = getCount();
+        return Count ? static_cast<uint32_t>(sum_.load(std::memory_order_relaxed) / Count) : 0;
+    }
+
+    const Metric* first(void) {
+        return head.load();
+    }
+
+    void print(FILE* out) {
+        char entry[METRICS_ENTRY_LENGTH];
+        for (const Metric* metric = first(); metric != nullptr; metric = metric->getNext()) {
+            formatMetric(*metric, entry, sizeof(entry));
+            fprintf(out, "%s\n", entry);
+        }
+        fflush(out);
+    }
+
+    void logSummary(void) {
+        char line[METRICS_LINE_LENGTH];
+        char entry[METRICS_ENTRY_LENGTH];
+        std::size_t length = 0;
+
+        for (const Metric* metric = first(); metric != nullptr; metric = metric->getNext()) {
+            const std::size_t EntryLength = std::min<std::size_t>(formatMetric(*metric, entry, sizeof(entry)),
+                                                                  sizeof(entry) - 1);
+            if (length != 0 && length + 1 + EntryLength >= sizeof(line)) {
+                ESP_LOGI(TAG, "%s", line);
+                length = 0;
+            }
+            if (length != 0) {
+                line[length++] = ' ';
+            }
+            memcpy(line + length, entry, EntryLength + 1);
+            length += EntryLength;
+        }
+        if (length != 0) {
+            ESP_LOGI(TAG, "%s", line);
+        }
+    }
+
+    esp_err_t registerCommand(void) {
+#if CONFIG_IDF_TARGET_LINUX
+        return ESP_ERR_NOT_SUPPORTED;
+#else
+        const esp_console_cmd_t Command = {
+            .command = "metrics",
+            .help = "Print counters, gauges and histograms (count/avg/p50/p99/max) since boot",
+            .hint = nullptr,
+            .func = &metricsCommand,
+        };
+        return esp_console_cmd_register(&Command);
+#endif
+    }
+}
@@ -0,0 +1,156 @@
+/**
+ * @brief Runtime metrics registry
+ *
+ * Named counters, gauges and fixed bucket histograms. Metrics are meant to be static
+ * objects, they link themselves into the registry on construction, nothing is allocated.
+ * Updates are single atomic operations, safe from any task. Values are totals since boot,
+ * so summaries of different units can be compared directly.
+ *
+ * Names must be string literals, the unit goes into the name suffix (e.g. "led.rmt_wait_us").
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include "esp_err.h"
+
+namespace metrics {
+
+    enum class Kind : uint8_t {
+        COUNTER,
+        GAUGE,
+        HISTOGRAM,
+    };
+
+    /**
+     * @brief Registry node, base of every metric
+     */
+    class Metric {
+    public:
+        Metric(const Metric&) = delete;
+        Metric& operator=(const Metric&) = delete;
+
+        const char* getName(void) const {
+            return name_;
+        }
+
+        Kind getKind(void) const {
+            return kind_;
+        }
+
+        const Metric* getNext(void) const {
+            return next_;
+        }
+
+    protected:
+        Metric(const char* name, Kind kind);
+        ~Metric() = default;
+
+    private:
+        const char* name_;
+        Kind kind_;
+        Metric* next_ = nullptr;
+    };
+
+    /**
+     * @brief Monotonic event count
+     */
+    class Counter : public Metric {
+    public:
+        explicit Counter(const char* name) : Metric(name, Kind::COUNTER) {}
+
+        void add(uint32_t count = 1) {
+            value_.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        uint32_t get(void) const {
+            return value_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint32_t> value_ {0};
+    };
+
+    /**
+     * @brief Last reported value
+     */
+    class Gauge : public Metric {
+    public:
+        explicit Gauge(const char* name) : Metric(name, Kind::GAUGE) {}
+
+        void set(int32_t value) {
+            value_.store(value, std::memory_order_relaxed);
+        }
+
+        int32_t get(void) const {
+            return value_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<int32_t> value_ {0};
+    };
+
+    /**
+     * @brief Distribution with power of two buckets
+     * @details Bucket 0 counts zeros, bucket i counts [2^(i-1), 2^i), the last bucket
+     * counts everything above
+     */
+    class Histogram : public Metric {
+    public:
+        static constexpr std::size_t Buckets = 24;
+
+        explicit Histogram(const char* name) : Metric(name, Kind::HISTOGRAM) {}
+
+        void add(uint32_t value);
+
+        /**
+         * @brief Upper bound of the bucket, UINT32_MAX for the last one
+         */
+        static uint32_t bucketLimit(std::size_t bucket);
+
+        /**
+         * @brief Smallest bucket limit covering at least percent of samples, capped by the maximum
+         */
+        uint32_t percentile(uint32_t percent) const;
+
+        uint32_t getCount(void) const {
+            return count_.load(std::memory_order_relaxed);
+        }
+
+        uint32_t getMax(void) const {
+            return max_.load(std::memory_order_relaxed);
+        }
+
+        uint32_t getAverage(void) const;
+
+    private:
+        std::atomic<uint32_t> buckets_[Buckets] {};
+        std::atomic<uint32_t> count_ {0};
+        std::atomic<uint64_t> sum_ {0};
+        std::atomic<uint32_t> max_ {0};
+    };
+
+    /**
+     * @brief First registered metric, metrics are linked by Metric::getNext()
+     */
+    const Metric* first(void);
+
+    /**
+     * @brief Print every metric on compact lines "name=value" / "name=n/avg/p50/p99/max"
+     */
+    void print(FILE* out);
+
+    /**
+     * @brief Same as print() through the log, lines are packed up to the log line length
+     */
+    void logSummary(void);
+
+    /**
+     * @brief Register "metrics" console command
+     * @note Console REPL must be created by the caller
+     */
+    esp_err_t registerCommand(void);
+}
@@ -0,0 +1,156 @@
+#include "local_clock.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <sys/time.h>
+
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#define TRANSITION_SEARCH_STEP_S    (7 * 24 * 3600)     //< DST transitions are months apart
+#define TRANSITION_SEARCH_HORIZON_S (366 * 24 * 3600)
+
+namespace {
+    /**
+     * @brief Published local time, valid for one generation until validUntilUs
+     */
+    typedef struct {
+        uint32_t generation;      ///< Invalidation generation the snapshot was built in
+        tm local;                 ///< Local time at baseUnix
+        time_t baseUnix;
+        int64_t baseUs;           ///< esp_timer time at the start of the baseUnix second
+        int64_t validUntilUs;     ///< esp_timer time of the next minute boundary or DST transition
+        time_t nextMinute;
+        time_t nextTransition;    ///< 0 if none before transitionHorizon
+        time_t transitionHorizon; ///< Transition search covers time up to this instant
+    } snapshot_t;
+
+    snapshot_t snapshot {};
+    std::atomic<uint32_t> sequence {0};      ///< Odd while the snapshot is being written
+    std::atomic<uint32_t> generation {1};    ///< Snapshot of generation 0 is never valid
+    std::atomic_flag rebuilding = ATOMIC_FLAG_INIT;
+
+    metrics::Counter rebuilds("time.local_rebuilds");
+
+    bool isSlewing(void) {
+#if CONFIG_IDF_TARGET_LINUX
+        /* Host clock is not slewed by NetTime*/
+        return false;
+#else
+        timeval pending = {};
+        return adjtime(nullptr, &pending) == 0 && (pending.tv_sec != 0 || pending.tv_usec != 0);
+#endif
+    }
+
+    /**
+     * @brief First instant after from with different DST flag, 0 if none before horizon
+     */
+    time_t findTransition(time_t from, time_t horizon) {
+        tm probe;
+        localtime_r(&from, &probe);
+        const int Dst = probe.tm_isdst;
+
+        time_t low = from;
+        for (time_t high = from + TRANSITION_SEARCH_STEP_S; low < horizon; high += TRANSITION_SEARCH_STEP_S) {
+            localtime_r(&high, &probe);
+            if (probe.tm_isdst == Dst) {
+                low = high;
+                continue;
+            }
+
+            /* low has the old flag, high the new one*/
+            while (high - low > 1) {
+                time_t middle = low + (high - low) / 2;
+                localtime_r(&middle, &probe);
+                (probe.tm_isdst == Dst ? low : high) = middle;
+            }
+            return high;
+        }
+        return 0;
+    }
+
+    bool readSnapshot(snapshot_t& copy) {
+        const uint32_t Begin = sequence.load(std::memory_order_acquire);
+        if (Begin & 1) {
+            return false;
+        }
+        copy = snapshot;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return sequence.load(std::memory_order_relaxed) == Begin;
+    }
+
+    /**
+     * @brief Compute local time from libc and publish it unless another task is doing that
+     */
+    snapshot_t rebuild(const snapshot_t& previous) {
+        const uint32_t Generation = generation.load();
+
+        timeval tv;
+        gettimeofday(&tv, nullptr);
+        const int64_t NowUs = esp_timer_get_time();
+
+        snapshot_t fresh = previous;
+        fresh.generation = Generation;
+        fresh.baseUnix = tv.tv_sec;
+        fresh.baseUs = NowUs - tv.tv_usec;
+        localtime_r(&tv.tv_sec, &fresh.local);
+        fresh.nextMinute = tv.tv_sec - fresh.local.tm_sec + 60;
+
+        const bool TransitionPassed = fresh.nextTransition != 0 && tv.tv_sec >= fresh.nextTransition;
+        if (previous.generation != Generation || TransitionPassed || tv.tv_sec >= fresh.transitionHorizon) {
+            fresh.transitionHorizon = tv.tv_sec + TRANSITION_SEARCH_HORIZON_S;
+            fresh.nextTransition = findTransition(tv.tv_sec, fresh.transitionHorizon);
+        }
+
+        time_t validUntil = fresh.nextTransition ? std::min(fresh.nextMinute, fresh.nextTransition) : fresh.nextMinute;
+        if (isSlewing()) {
+            /* Wall clock runs off esp_timer while adjtime slews, follow it every second*/
+            validUntil = tv.tv_sec + 1;
+        }
+        fresh.validUntilUs = fresh.baseUs + static_cast<int64_t>(validUntil - fresh.baseUnix) * 1'000'000;
+
+        if (!rebuilding.test_and_set(std::memory_order_acquire)) {
+            sequence.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            snapshot = fresh;
+            sequence.fetch_add(1, std::memory_order_release);
+            rebuilding.clear(std::memory_order_release);
+        }
+        rebuilds.add();
+        return fresh;
+    }
+
+    snapshot_t current(int64_t nowUs) {
+        snapshot_t copy;
+        if (!readSnapshot(copy)) {
+            /* Writer is publishing right now, the previous snapshot is not worth waiting for*/
+            copy = {};
+        }
+        if (copy.generation != generation.load() || nowUs < copy.baseUs || nowUs >= copy.validUntilUs) {
+            copy = rebuild(copy);
+        }
+        return copy;
+    }
+}
+
+tm LocalClock::now(void) {
+    const int64_t NowUs = esp_timer_get_time();
+    const snapshot_t Snapshot = current(NowUs);
+
+    tm local = Snapshot.local;
+    local.tm_sec += static_cast<int>((NowUs - Snapshot.baseUs) / 1'000'000);
+    return local;
+}
+
+time_t LocalClock::getNextMinute(void) {
+    return current(esp_timer_get_time()).nextMinute;
+}
+
+time_t LocalClock::getNextTransition(void) {
+    return current(esp_timer_get_time()).nextTransition;
+}
+
+void LocalClock::invalidate(void) {
+    generation.fetch_add(1);
+}
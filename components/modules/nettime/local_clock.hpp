@@ -0,0 +1,35 @@
+#pragma once
+
+#include "time.h"
+
+/**
+ * @brief Cached local wall clock
+ *
+ * Broken-down local time is computed with localtime_r once per minute boundary, after
+ * a DST transition and after invalidate(). In between seconds are derived from the
+ * monotonic esp_timer offset, so readers get the current tm in constant time without
+ * touching libc TZ state. While adjtime slews the clock, time is rebuilt every second.
+ * Safe to call from any task.
+ */
+class LocalClock {
+public:
+    /**
+     * @brief Current local time
+     */
+    static tm now(void);
+
+    /**
+     * @brief UTC time of the next minute boundary
+     */
+    static time_t getNextMinute(void);
+
+    /**
+     * @brief UTC time of the next DST transition, 0 if there is none within a year
+     */
+    static time_t getNextTransition(void);
+
+    /**
+     * @brief Drop cached time, must be called after the clock was stepped or TZ changed
+     */
+    static void invalidate(void);
+};
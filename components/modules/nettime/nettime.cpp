@@ -1,17 +1,108 @@
 #include "nettime.hpp"
-#include "esp_netif_sntp.h"
-#include "esp_sntp.h"
+#include "local_clock.hpp"
+#include "ntp_client.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
 #include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_bit_defs.h"
+#include "nvs.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_attr.h"
+#endif
 #include "assert.h"
+#include <atomic>
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdlib>
+#include <sys/time.h>
 
 static const char *TAG = "nettime";
 
-const std::string NetTime::DefaultNtpServer = "pool.ntp.org";
+#define NTP_TASK_STACK_SIZE     (4 * 1024)
+#define NTP_TASK_PRIORITY       (3)
+#define NTP_RETRY_MIN_MS        (2000)      //< first retry after a failed poll, doubles up to the poll interval
+#define NTP_DRIFT_STEP_MS       (60 * 1000) //< drift is compensated in steps this far apart between polls
+#define NTP_DRIFT_MIN_SPAN_S    (64)        //< offsets over shorter spans are too noisy to estimate drift
+#define NTP_DRIFT_GAIN          (0.5f)      //< weight of a new drift measurement
+#define NTP_DRIFT_MAX_PPM       (500.0f)    //< NTP frequency tolerance, a larger estimate is a measurement error
+#define NTP_DRIFT_SAVE_PPM      (0.1f)      //< smaller estimate changes are not worth a flash write
+
+#define NVS_NAMESPACE           "nettime"
+#define NVS_KEY_DRIFT           "drift_ppb"
+#define NVS_KEY_POLL_INTERVAL   "poll_s"
+#define NVS_KEY_TIMEZONE        "tz"
+#define TIMEZONE_MAX_LENGTH     (64)
+
+#define RTC_TIME_MAGIC          (0x4E54494Du)   //< "NTIM"
+
+const std::string NetTime::DefaultNtpServer = CONFIG_NETTIME_SERVERS;
 bool NetTime::isInited_ = false;
 bool NetTime::isSynced_ = false;
+bool NetTime::isRestored_ = false;
 std::string NetTime::ntpServer_ = NetTime::DefaultNtpServer;
 std::string NetTime::timezone_{"UTC0"};
 NetTime::SyncCallback NetTime::syncCallback_ = nullptr;
+NetTime::SyncCallback NetTime::pendingCallback_ = nullptr;
+
+#define SYNC_DONE_FLAG      BIT0
+#define SYNC_FAILED_FLAG    BIT1
+
+static metrics::Histogram syncLatencyMs("time.sync_ms");
+static metrics::Counter syncFailures("time.sync_fail");
+static metrics::Histogram ntpDelayMs("time.ntp_delay_ms");
+static metrics::Gauge ntpOffsetMs("time.ntp_offset_ms");
+static metrics::Counter clockSteps("time.steps");
+static metrics::Gauge driftPpb("time.drift_ppb");
+static metrics::Gauge pollIntervalS("time.poll_s");
+
+static EventGroupHandle_t syncEvents;
+static esp_timer_handle_t syncTimer;        //< fails requested sync after its timeout
+static std::atomic<bool> syncPending {false};
+static std::atomic<int64_t> syncStartUs {0}; //< 0 if no sync latency is being measured
+
+static ntp::Client ntpClient;               //< owned by the NTP task
+static TaskHandle_t ntpTask;
+static std::atomic<bool> serversChanged {false};
+
+/**
+ * @brief Clock discipline state, owned by the NTP task
+ */
+typedef struct {
+    float driftPpm;               ///< Local clock rate error, positive if it runs slow
+    bool driftKnown;
+    uint32_t pollIntervalS;
+    int64_t correctedUs;          ///< esp_timer time of the last NTP correction, 0 before the first one
+    int64_t lastOffsetUs;         ///< Offset the last correction left on the clock
+    int64_t compensationUs;       ///< Drift compensation applied since the last correction
+    int64_t compensatedUs;        ///< esp_timer time drift is compensated up to
+    float carryUs;                ///< Compensation below 1 us not applied yet
+    float savedDriftPpm;
+    uint32_t savedPollIntervalS;
+} discipline_t;
+
+static discipline_t discipline;
+
+#if !CONFIG_IDF_TARGET_LINUX
+/**
+ * @brief Last sync, kept in RTC memory like the system time itself
+ * @details Both survive software resets and deep sleep but not a power loss, a valid
+ * record not newer than the clock proves the clock kept running since that sync.
+ */
+typedef struct {
+    time_t syncedUnix;
+    uint32_t check;             ///< RTC_TIME_MAGIC xor syncedUnix, garbage after power on
+} rtc_time_t;
+
+static RTC_NOINIT_ATTR rtc_time_t rtcTime;
+#endif
 
 static SemaphoreHandle_t mutex;
 static uint32_t mutexTimeoutMs = 1000;
@@ -26,72 +117,445 @@ static uint32_t mutexTimeoutMs = 1000;
 
 #define MUTEX_UNLOCK(m) xSemaphoreGive(m)
 
+/**
+ * @brief Part of the last slew adjtime did not apply yet
+ */
+static int64_t pendingSlewUs(void) {
+#if CONFIG_IDF_TARGET_LINUX
+    return 0;
+#else
+    timeval pending = {};
+    if (adjtime(nullptr, &pending) != 0) {
+        return 0;
+    }
+    return static_cast<int64_t>(pending.tv_sec) * 1'000'000 + pending.tv_usec;
+#endif
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+/**
+ * @brief Slew the clock by slewUs on top of the pending slew
+ */
+static void slewBy(int64_t slewUs) {
+    /* New adjtime call replaces the pending slew*/
+    const int64_t TotalUs = slewUs + pendingSlewUs();
+    const timeval Slew = {
+        .tv_sec = static_cast<time_t>(TotalUs / 1'000'000),
+        .tv_usec = static_cast<suseconds_t>(TotalUs % 1'000'000),
+    };
+    adjtime(&Slew, nullptr);
+}
+#endif
+
+/**
+ * @brief Time kept by the RTC since the last sync of a previous boot is good to show right away
+ */
+static bool restoreTime(void) {
+#if CONFIG_IDF_TARGET_LINUX
+    return false;
+#else
+    const time_t Now = time(nullptr);
+    if (rtcTime.check != (RTC_TIME_MAGIC ^ static_cast<uint32_t>(rtcTime.syncedUnix)) || Now < rtcTime.syncedUnix) {
+        ESP_LOGI(TAG, "restoreTime: no time kept over reset, waiting for sync");
+        return false;
+    }
+    ESP_LOGI(TAG, "restoreTime: clock kept over reset, last synced %" PRId64 " s ago",
+             static_cast<int64_t>(Now - rtcTime.syncedUnix));
+    return true;
+#endif
+}
+
+/**
+ * @brief Timezone stored by setTimezone() on a previous boot
+ */
+static bool loadTimezone(std::string& tz) {
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    char stored[TIMEZONE_MAX_LENGTH];
+    std::size_t length = sizeof(stored);
+    const bool Found = nvs_get_str(nvs, NVS_KEY_TIMEZONE, stored, &length) == ESP_OK;
+    nvs_close(nvs);
+
+    if (Found) {
+        tz = stored;
+    }
+    return Found;
+}
+
+static void saveTimezone(const std::string& tz) {
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret == ESP_OK) {
+        ret = nvs_set_str(nvs, NVS_KEY_TIMEZONE, tz.c_str());
+        if (ret == ESP_OK) {
+            ret = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "saveTimezone: unable to store timezone: %s", esp_err_to_name(ret));
+    }
+}
+
+/**
+ * @brief Restore drift estimate and poll interval of the previous boots
+ */
+static void loadDiscipline(void) {
+    discipline.pollIntervalS = CONFIG_NETTIME_POLL_INTERVAL_S;
+
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        ESP_LOGI(TAG, "loadDiscipline: no stored drift, estimating from scratch");
+        return;
+    }
+
+    int32_t storedDriftPpb;
+    if (nvs_get_i32(nvs, NVS_KEY_DRIFT, &storedDriftPpb) == ESP_OK) {
+        discipline.driftPpm = std::clamp(storedDriftPpb / 1000.0f, -NTP_DRIFT_MAX_PPM, NTP_DRIFT_MAX_PPM);
+        discipline.driftKnown = true;
+    }
+    uint32_t storedPollS;
+    if (discipline.driftKnown && nvs_get_u32(nvs, NVS_KEY_POLL_INTERVAL, &storedPollS) == ESP_OK) {
+        discipline.pollIntervalS = std::clamp<uint32_t>(storedPollS, CONFIG_NETTIME_POLL_INTERVAL_S, CONFIG_NETTIME_POLL_MAX_S);
+    }
+    nvs_close(nvs);
+
+    discipline.savedDriftPpm = discipline.driftPpm;
+    discipline.savedPollIntervalS = discipline.pollIntervalS;
+    ESP_LOGI(TAG, "loadDiscipline: drift %.3f ppm, poll interval %" PRIu32 " s",
+             discipline.driftPpm, discipline.pollIntervalS);
+}
+
+static void saveDiscipline(void) {
+    if (!discipline.driftKnown ||
+        (std::fabs(discipline.driftPpm - discipline.savedDriftPpm) < NTP_DRIFT_SAVE_PPM &&
+         discipline.pollIntervalS == discipline.savedPollIntervalS)) {
+        return;
+    }
+
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret == ESP_OK) {
+        ret = nvs_set_i32(nvs, NVS_KEY_DRIFT, static_cast<int32_t>(std::lround(discipline.driftPpm * 1000.0f)));
+        if (ret == ESP_OK) {
+            ret = nvs_set_u32(nvs, NVS_KEY_POLL_INTERVAL, discipline.pollIntervalS);
+        }
+        if (ret == ESP_OK) {
+            ret = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "saveDiscipline: unable to store drift: %s", esp_err_to_name(ret));
+        return;
+    }
+    discipline.savedDriftPpm = discipline.driftPpm;
+    discipline.savedPollIntervalS = discipline.pollIntervalS;
+}
+
+/**
+ * @brief Estimate drift from the offset accumulated since the last correction and adapt the poll interval
+ * @param stepped Clock was stepped, the offset says nothing about its rate
+ */
+static void updateDiscipline(int64_t offsetUs, bool stepped) {
+    const int64_t NowUs = esp_timer_get_time();
+    const int64_t SpanUs = NowUs - discipline.correctedUs;
+    const int64_t ErrorUs = offsetUs - discipline.lastOffsetUs;
+    const bool HaveBaseline = discipline.correctedUs != 0 && !stepped;
+
+    if (HaveBaseline && SpanUs >= NTP_DRIFT_MIN_SPAN_S * 1'000'000LL) {
+        /* Error left over by compensation plus the compensation itself is the full rate error*/
+        const float RatePpm = static_cast<float>(ErrorUs + discipline.compensationUs) * 1e6f / static_cast<float>(SpanUs);
+        const float DriftPpm = discipline.driftKnown ? discipline.driftPpm + NTP_DRIFT_GAIN * (RatePpm - discipline.driftPpm)
+                                                     : RatePpm;
+        discipline.driftPpm = std::clamp(DriftPpm, -NTP_DRIFT_MAX_PPM, NTP_DRIFT_MAX_PPM);
+        discipline.driftKnown = true;
+
+        /* Stretch polls while the clock holds the target, fall back quickly once it does not*/
+        if (std::llabs(ErrorUs) <= static_cast<int64_t>(CONFIG_NETTIME_TARGET_ERROR_MS) * 1000) {
+            discipline.pollIntervalS = std::min<uint32_t>(discipline.pollIntervalS * 2, CONFIG_NETTIME_POLL_MAX_S);
+        } else {
+            discipline.pollIntervalS = std::max<uint32_t>(discipline.pollIntervalS / 2, CONFIG_NETTIME_POLL_INTERVAL_S);
+        }
+        ESP_LOGI(TAG, "updateDiscipline: error %" PRId64 " us over %" PRId64 " s, drift %.3f ppm, next poll in %" PRIu32 " s",
+                 ErrorUs, SpanUs / 1'000'000, discipline.driftPpm, discipline.pollIntervalS);
+    } else if (stepped && discipline.correctedUs != 0) {
+        /* Clock went far off since the last sync, the estimate is not trusted until it holds again*/
+        discipline.pollIntervalS = CONFIG_NETTIME_POLL_INTERVAL_S;
+    }
+
+    discipline.correctedUs = NowUs;
+    discipline.compensatedUs = NowUs;
+    discipline.compensationUs = 0;
+    discipline.carryUs = 0;
+#if CONFIG_IDF_TARGET_LINUX
+    /* Host clock is not corrected, the offset stays on it*/
+    discipline.lastOffsetUs = offsetUs;
+#else
+    discipline.lastOffsetUs = 0;
+#endif
+
+    driftPpb.set(static_cast<int32_t>(std::lround(discipline.driftPpm * 1000.0f)));
+    pollIntervalS.set(static_cast<int32_t>(discipline.pollIntervalS));
+    saveDiscipline();
+}
+
 esp_err_t NetTime::init(const std::string& tz, const std::string& ntpServer, NetTime::SyncCallback syncCb) {
     assert(!isInited_);
+    TRACE_SCOPE("time.init");
+
+    ESP_RETURN_ON_ERROR(ntpClient.setServers(ntpServer.c_str()), TAG, "init: invalid NTP server list");
 
     mutex = xSemaphoreCreateRecursiveMutex();
     assert(mutex);
+    syncEvents = xEventGroupCreate();
+    assert(syncEvents);
+
+    const esp_timer_create_args_t TimerArgs = {
+        .callback = &NetTime::syncTimeout,
+        .arg = nullptr,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "syncTimeout",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&TimerArgs, &syncTimer));
+
+    loadDiscipline();
 
     ntpServer_ = ntpServer;
     /* Define user after time sync callback*/
     syncCallback_ = syncCb;
     timezone_ = tz;
-
-    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG(ntpServer_.c_str());
-    config.sync_cb = sntpCallback; //< would call usert time sync callback
-    config.start = true;
-    config.server_from_dhcp = false;
-    config.renew_servers_after_new_IP = true;
-    config.ip_event_to_renew = IP_EVENT_STA_GOT_IP;
-    
-    esp_err_t ret = esp_netif_sntp_init(&config);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "init: failed: %s", esp_err_to_name(ret));
-        return ret;
+    if (loadTimezone(timezone_)) {
+        ESP_LOGI(TAG, "init: using stored timezone %s", timezone_.c_str());
     }
-    
+
     setenv("TZ", timezone_.c_str(), 1);
     tzset();
-
+    LocalClock::invalidate();
+    isRestored_ = restoreTime();
     isInited_ = true;
-    ESP_LOGI(TAG, "init: initialized with NTP server: %s", ntpServer_.c_str());
+
+#if CONFIG_IDF_TARGET_LINUX
+    /* Host clock is already disciplined by the host OS, NTP only measures it*/
+    syncDone();
+#endif
+
+    if (xTaskCreate(&NetTime::ntpTaskLoop, "ntpTask", NTP_TASK_STACK_SIZE, nullptr, NTP_TASK_PRIORITY, &ntpTask) != pdPASS) {
+        ESP_LOGE(TAG, "init: NTP task creation failed (insufficient heap?)");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "init: initialized with NTP servers: %s", ntpServer_.c_str());
+    return ESP_OK;
+}
+
+void NetTime::ntpTaskLoop(void* arg) {
+    /* Network may not be up yet, the first poll waits for a sync request*/
+    int64_t nextPollUs = INT64_MAX;
+    uint32_t retryMs = NTP_RETRY_MIN_MS;
+
+    while (1) {
+        /* Wake for drift compensation between polls, notified by sync requests and server changes*/
+        const int64_t WaitUs = std::clamp<int64_t>(nextPollUs - esp_timer_get_time(), 0, NTP_DRIFT_STEP_MS * 1000LL);
+        const uint32_t WaitMs = static_cast<uint32_t>((WaitUs + 999) / 1000);
+        const bool Requested = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WaitMs)) != 0;
+
+        compensateDrift();
+
+        if (serversChanged.exchange(false)) {
+            MUTEX_LOCK(mutex);
+            const std::string Servers = ntpServer_;
+            MUTEX_UNLOCK(mutex);
+            if (ntpClient.setServers(Servers.c_str()) != ESP_OK) {
+                ESP_LOGE(TAG, "ntpTask: keeping previous servers");
+            }
+        }
+
+        if (!Requested && esp_timer_get_time() < nextPollUs) {
+            continue;
+        }
+
+        if (pollServers() == ESP_OK) {
+            nextPollUs = esp_timer_get_time() + static_cast<int64_t>(discipline.pollIntervalS) * 1'000'000;
+            retryMs = NTP_RETRY_MIN_MS;
+        } else {
+            nextPollUs = esp_timer_get_time() + static_cast<int64_t>(retryMs) * 1000;
+            retryMs = std::min<uint32_t>(retryMs * 2, CONFIG_NETTIME_POLL_INTERVAL_S * 1000);
+        }
+    }
+}
+
+esp_err_t NetTime::pollServers(void) {
+    TRACE_SCOPE("time.poll");
+
+    ntp::result_t result;
+    const esp_err_t Ret = ntpClient.poll(CONFIG_NETTIME_RESPONSE_TIMEOUT_MS, pendingSlewUs(), result);
+    if (Ret != ESP_OK) {
+        ESP_LOGW(TAG, "pollServers: no usable answer: %s", esp_err_to_name(Ret));
+        return Ret;
+    }
+
+    if (result.sample.takenUs <= discipline.correctedUs) {
+        /* Filter kept the sample the clock was already corrected by. Servers answered, so the clock
+           is as good as after that correction: no new offset for the discipline, poll on schedule*/
+        ESP_LOGI(TAG, "pollServers: %zu/%zu answered, selected sample predates the last correction, clock kept",
+                 result.answered, ntpClient.getServerCount());
+        syncDone();
+        return ESP_OK;
+    }
+
+    const ntp::server_t& Server = ntpClient.getServer(result.server);
+    ntpDelayMs.add(static_cast<uint32_t>(result.sample.delayUs / 1000));
+    ntpOffsetMs.set(static_cast<int32_t>(result.sample.offsetUs / 1000));
+    ESP_LOGI(TAG, "pollServers: %zu/%zu answered, selected %s stratum %u offset %" PRId64 " us delay %" PRId64 " us",
+             result.answered, ntpClient.getServerCount(), Server.host, Server.stratum,
+             result.sample.offsetUs, result.sample.delayUs);
+
+    const bool Stepped = correctClock(result.sample.offsetUs);
+    updateDiscipline(result.sample.offsetUs, Stepped);
+    syncDone();
     return ESP_OK;
 }
 
-esp_err_t NetTime::sync(void) {
+bool NetTime::correctClock(int64_t offsetUs) {
+#if CONFIG_IDF_TARGET_LINUX
+    /* Unprivileged process can not adjust the host clock, samples stay relative to it*/
+    ESP_LOGI(TAG, "correctClock: host clock is not adjusted (offset %" PRId64 " us)", offsetUs);
+    return false;
+#else
+    bool stepped = false;
+    if (!isTimeValid() || std::llabs(offsetUs) > static_cast<int64_t>(CONFIG_NETTIME_STEP_THRESHOLD_MS) * 1000) {
+        /* Clock was never set or is too far off to slew in reasonable time.
+           Offset is relative to the clock with the pending slew applied, the step takes it over*/
+        const int64_t StepUs = offsetUs + pendingSlewUs();
+        const timeval NoSlew = {};
+        adjtime(&NoSlew, nullptr);
+
+        timeval now;
+        gettimeofday(&now, nullptr);
+        const int64_t CorrectedUs = static_cast<int64_t>(now.tv_sec) * 1'000'000 + now.tv_usec + StepUs;
+        const timeval Corrected = {
+            .tv_sec = static_cast<time_t>(CorrectedUs / 1'000'000),
+            .tv_usec = static_cast<suseconds_t>(CorrectedUs % 1'000'000),
+        };
+        settimeofday(&Corrected, nullptr);
+        LocalClock::invalidate();
+        clockSteps.add();
+        stepped = true;
+        ESP_LOGI(TAG, "correctClock: stepped by %" PRId64 " us", StepUs);
+    } else {
+        /* Offset is relative to the clock with the pending slew applied*/
+        slewBy(offsetUs);
+        ESP_LOGD(TAG, "correctClock: slewing by %" PRId64 " us", offsetUs);
+    }
+    /* Samples are relative to the clock with the pending slew applied, it moved by offsetUs either way*/
+    ntpClient.applyCorrection(offsetUs);
+    return stepped;
+#endif
+}
+
+void NetTime::compensateDrift(void) {
+#if !CONFIG_IDF_TARGET_LINUX
+    const int64_t NowUs = esp_timer_get_time();
+    const int64_t ElapsedUs = NowUs - discipline.compensatedUs;
+    discipline.compensatedUs = NowUs;
+    if (!isSynced_ || !discipline.driftKnown) {
+        return;
+    }
+
+    discipline.carryUs += discipline.driftPpm * static_cast<float>(ElapsedUs) / 1e6f;
+    const int64_t StepUs = static_cast<int64_t>(discipline.carryUs);
+    if (StepUs == 0) {
+        return;
+    }
+    discipline.carryUs -= static_cast<float>(StepUs);
+    discipline.compensationUs += StepUs;
+
+    slewBy(StepUs);
+    ntpClient.applyCorrection(StepUs);
+    ESP_LOGD(TAG, "compensateDrift: slewing by %" PRId64 " us", StepUs);
+#endif
+}
+
+esp_err_t NetTime::syncAsync(NetTime::SyncCallback callback, uint32_t timeoutMs) {
     assert(isInited_);
     assert(mutex);
-
-    isSynced_ = false;
+    TRACE_INSTANT("time.sync_request");
 
     MUTEX_LOCK(mutex);
-    bool restartSuccess = esp_sntp_restart();
+    if (syncPending.load()) {
+        MUTEX_UNLOCK(mutex);
+        ESP_LOGW(TAG, "syncAsync: sync already in progress");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    pendingCallback_ = std::move(callback);
+    xEventGroupClearBits(syncEvents, SYNC_DONE_FLAG | SYNC_FAILED_FLAG);
+    syncStartUs.store(esp_timer_get_time());
+    syncPending.store(true);
+
+    /* Time stays valid while resyncing, isSynced_ is left as is*/
+    esp_timer_start_once(syncTimer, static_cast<uint64_t>(timeoutMs) * 1000);
     MUTEX_UNLOCK(mutex);
 
-    if (!restartSuccess) {
-        ESP_LOGE(TAG, "sync: failed to restart sntp");
-        MUTEX_UNLOCK(mutex);
-        return ESP_FAIL;
+    xTaskNotifyGive(ntpTask);
+    return ESP_OK;
+}
+
+esp_err_t NetTime::sync(uint32_t timeoutMs) {
+    TRACE_SCOPE("time.sync");
+
+    const esp_err_t Ret = syncAsync(nullptr, timeoutMs);
+    if (Ret != ESP_OK) {
+        return Ret;
+    }
+
+    const EventBits_t Flags = xEventGroupWaitBits(syncEvents, SYNC_DONE_FLAG | SYNC_FAILED_FLAG,
+                                                  pdFALSE, pdFALSE, pdMS_TO_TICKS(timeoutMs));
+    if (Flags & SYNC_DONE_FLAG) {
+        return ESP_OK;
+    }
+    if ((Flags & SYNC_FAILED_FLAG) == 0) {
+        /* Timer task is late or busy, do not leave the sync pending*/
+        finishSync(false);
+    }
+    ESP_LOGE(TAG, "sync: time sync timeout after %" PRIu32 " ms", timeoutMs);
+    return ESP_ERR_TIMEOUT;
+}
+
+void NetTime::finishSync(bool success) {
+    if (!syncPending.load()) {
+        return;
     }
 
-    int retry = 0;
-    const int retryMaxCount = 15;
-    while (retry < retryMaxCount) {
-        MUTEX_LOCK(mutex);
-        bool synced = (sntp_get_sync_status() == SNTP_SYNC_STATUS_COMPLETED);
+    /* Completion and timeout may race, only one of them takes the callback*/
+    MUTEX_LOCK(mutex);
+    if (!syncPending.load()) {
         MUTEX_UNLOCK(mutex);
-        
-        if (synced) {
-            isSynced_ = true;
-            return ESP_OK;
-        }
-        
-        ESP_LOGI(TAG, "sync: waiting for time sync... (%d/%d)", ++retry, retryMaxCount);
-        vTaskDelay(pdMS_TO_TICKS(2000));
+        return;
     }
+    SyncCallback callback = std::move(pendingCallback_);
+    pendingCallback_ = nullptr;
+    syncPending.store(false);
+    MUTEX_UNLOCK(mutex);
 
-    ESP_LOGE(TAG, "sync: time sync timeout");
-    return ESP_ERR_TIMEOUT;
+    esp_timer_stop(syncTimer);
+    if (!success) {
+        syncStartUs.store(0);
+        syncFailures.add();
+    }
+    xEventGroupSetBits(syncEvents, success ? SYNC_DONE_FLAG : SYNC_FAILED_FLAG);
+    if (callback) {
+        callback(success);
+    }
+}
+
+void NetTime::syncTimeout(void* arg) {
+    ESP_LOGW(TAG, "syncTimeout: no response from NTP server");
+    finishSync(false);
 }
 
 bool NetTime::isInited(void) {
@@ -104,11 +568,28 @@ bool NetTime::isSynced(void) {
     return isSynced_;
 }
 
-void NetTime::sntpCallback(struct timeval *tv) {
+bool NetTime::isTimeValid(void) {
+    assert(isInited_);
+
+    return isSynced_ || isRestored_;
+}
+
+void NetTime::syncDone(void) {
     assert(isInited_);
 
     isSynced_ = true;
-    ESP_LOGI(TAG, "sntpCallback: time synchronized");
+    TRACE_INSTANT("time.synced");
+#if !CONFIG_IDF_TARGET_LINUX
+    rtcTime.syncedUnix = time(nullptr);
+    rtcTime.check = RTC_TIME_MAGIC ^ static_cast<uint32_t>(rtcTime.syncedUnix);
+#endif
+
+    const int64_t StartUs = syncStartUs.exchange(0);
+    if (StartUs != 0) {
+        syncLatencyMs.add(static_cast<uint32_t>((esp_timer_get_time() - StartUs) / 1000));
+    }
+    ESP_LOGD(TAG, "syncDone: time synchronized");
+    finishSync(true);
     
     if (syncCallback_) {
         syncCallback_(true);
@@ -128,23 +609,41 @@ time_t NetTime::getUnixTime(void) {
 tm NetTime::getLocalTime(void) {
     assert(isInited_);
 
-    const time_t now = getUnixTime();
-    tm timeinfo;
-    localtime_r(&now, &timeinfo);
-
-    return timeinfo;
+    return LocalClock::now();
 }
 
 std::string NetTime::getLocalTimeString(const char* format) {
     assert(isInited_);
     
-    const time_t now = getUnixTime();
     char buf[64];
-    strftime(buf, sizeof(buf), format, localtime(&now));
+    formatLocalTime(format, buf, sizeof(buf));
 
     return std::string(buf);
 }
 
+std::size_t NetTime::formatLocalTime(const time_format::Spec& spec, char* buf, std::size_t size) {
+    assert(isInited_);
+
+    return spec.format(LocalClock::now(), buf, size);
+}
+
+std::size_t NetTime::formatLocalTime(const char* format, char* buf, std::size_t size) {
+    assert(isInited_);
+
+    const tm Local = LocalClock::now();
+    const std::size_t Length = strftime(buf, size, format, &Local);
+    if (Length == 0 && size > 0) {
+        buf[0] = '\0';
+    }
+    return Length;
+}
+
+time_format::Text NetTime::getLocalTimeText(const time_format::Spec& spec) {
+    time_format::Text text;
+    text.setSize(formatLocalTime(spec, text.data(), time_format::Text::Capacity));
+    return text;
+}
+
 void NetTime::setTimezone(const std::string& tz) {
     assert(isInited_);
     assert(mutex);
@@ -154,6 +653,8 @@ void NetTime::setTimezone(const std::string& tz) {
     timezone_ = tz;
     setenv("TZ", timezone_.c_str(), 1);
     tzset();
+    LocalClock::invalidate();
+    saveTimezone(timezone_);
     
     MUTEX_UNLOCK(mutex);
 }
@@ -167,9 +668,20 @@ std::string NetTime::getTimezone(void) {
 std::string NetTime::getNtpServer(void) {
     assert(isInited_);
 
-    return ntpServer_;
+    MUTEX_LOCK(mutex);
+    const std::string Servers = ntpServer_;
+    MUTEX_UNLOCK(mutex);
+    return Servers;
 }
 
 void NetTime::setNtpServer(const std::string& server) {
+    assert(isInited_);
+
+    MUTEX_LOCK(mutex);
+    ntpServer_ = server;
+    MUTEX_UNLOCK(mutex);
 
+    /* NTP task owns the client, it picks the list up and polls right away*/
+    serversChanged.store(true);
+    xTaskNotifyGive(ntpTask);
 }
\ No newline at end of file
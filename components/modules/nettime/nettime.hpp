@@ -2,34 +2,87 @@
 
 #include "time.h"
 #include "esp_err.h"
+#include "time_format.hpp"
+#include <cstdint>
 #include <functional>
 #include <string>
 
 class NetTime {
 public:
     using SyncCallback = std::function<void(bool success)>;
-    static const std::string DefaultNtpServer;
+    static const std::string DefaultNtpServer; //< CONFIG_NETTIME_SERVERS
 
+    /**
+     * @brief Set timezone and start the NTP task
+     * @details Needs no network: time kept by the RTC over a software reset is valid right away.
+     * Servers are polled from the first sync()/syncAsync() on, call it once the network is up.
+     * @param tz Used unless setTimezone() stored another one on a previous boot
+     * @param ntpServer Servers queried in parallel, "host[:port],host[:port],..." up to 4
+     * @param syncCb Called once after the first successful sync
+     */
     static esp_err_t init(const std::string& tz = "UTC0", const std::string& ntpServer = DefaultNtpServer, NetTime::SyncCallback syncCb = nullptr);
     static bool isInited(void);
     
-    static void setTimezone(const std::string& tz);
+    static void setTimezone(const std::string& tz); //< Stored in NVS, survives reboots
     static std::string getTimezone(void);
     
     static time_t getUnixTime(void); //< UTC time
-    static tm getLocalTime(void);    //< Timezone offset
-    static std::string getLocalTimeString(const char* format);
+    static tm getLocalTime(void);    //< Timezone offset, cached by LocalClock
+    static std::string getLocalTimeString(const char* format); //< Allocates, use formatLocalTime() in periodic code
+
+    /**
+     * @brief Format current local time with a precompiled spec, no heap, safe from any task
+     * @return Formatted length, 0 if buffer is too small
+     */
+    static std::size_t formatLocalTime(const time_format::Spec& spec, char* buf, std::size_t size);
+
+    /**
+     * @brief Format current local time with any strftime format, no heap, safe from any task
+     * @return Formatted length, 0 if buffer is too small
+     */
+    static std::size_t formatLocalTime(const char* format, char* buf, std::size_t size);
+
+    /**
+     * @brief Current local time as fixed capacity text, e.g. getLocalTimeText(time_format::HourMinute)
+     */
+    static time_format::Text getLocalTimeText(const time_format::Spec& spec);
 
     static std::string getNtpServer(void);
-    static void setNtpServer(const std::string& server);
+    static void setNtpServer(const std::string& server); //< Same list format as init(), polled right away
 
-    static esp_err_t sync(void);
+    static constexpr uint32_t DefaultSyncTimeoutMs = 30000;
+
+    /**
+     * @brief Poll NTP servers now and return immediately
+     * @param callback Called once with the result, from NTP or timer task context
+     * @retval ESP_ERR_INVALID_STATE if another sync is in progress
+     */
+    static esp_err_t syncAsync(NetTime::SyncCallback callback, uint32_t timeoutMs = DefaultSyncTimeoutMs);
+
+    /**
+     * @brief Poll NTP servers now and wait until time is synchronized
+     * @retval ESP_ERR_TIMEOUT if no server answered within timeoutMs
+     */
+    static esp_err_t sync(uint32_t timeoutMs = DefaultSyncTimeoutMs);
     static bool isSynced(void);
+
+    /**
+     * @brief Time is good to show: synchronized in this boot or kept by the RTC since a previous sync
+     */
+    static bool isTimeValid(void);
 private:
-    static void sntpCallback(struct timeval *tv);
+    static void ntpTaskLoop(void* arg);
+    static esp_err_t pollServers(void);
+    static bool correctClock(int64_t offsetUs); //< true if the clock was stepped
+    static void compensateDrift(void);
+    static void syncDone(void);
+    static void finishSync(bool success);
+    static void syncTimeout(void* arg);
     static bool isInited_;
     static bool isSynced_;
+    static bool isRestored_;             ///< Clock kept running over a reset since a previous sync
     static std::string ntpServer_;
     static std::string timezone_;
-    static SyncCallback syncCallback_;
+    static SyncCallback syncCallback_;   ///< Notified once by the first sync after init
+    static SyncCallback pendingCallback_; ///< Notified by the requested sync
 };
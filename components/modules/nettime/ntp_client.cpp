@@ -0,0 +1,339 @@
+#include "ntp_client.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netdb.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#define NTP_PACKET_SIZE         (48)
+#define NTP_UNIX_EPOCH_OFFSET   (2208988800ULL)  //< seconds from 1900 to 1970
+#define NTP_LI_UNSYNCHRONIZED   (3)
+#define NTP_MODE_CLIENT         (3)
+#define NTP_MODE_SERVER         (4)
+#define NTP_VERSION             (4)
+#define NTP_MAX_STRATUM         (15)
+#define NTP_MAX_DISAGREEMENT_US (128 * 1000)     //< NTP step threshold, larger disagreement is a falseticker
+#define NTP_PHI_PPM             (15)              //< NTP frequency tolerance, dispersion growth of a sample with age
+
+static const char *TAG = "ntp";
+
+namespace {
+    int64_t wallTimeUs(void) {
+        timeval tv;
+        gettimeofday(&tv, nullptr);
+        return static_cast<int64_t>(tv.tv_sec) * 1'000'000 + tv.tv_usec;
+    }
+
+    uint32_t readU32(const uint8_t* bytes) {
+        return (uint32_t{bytes[0]} << 24) | (uint32_t{bytes[1]} << 16) | (uint32_t{bytes[2]} << 8) | bytes[3];
+    }
+
+    void writeU32(uint8_t* bytes, uint32_t value) {
+        bytes[0] = value >> 24;
+        bytes[1] = value >> 16;
+        bytes[2] = value >> 8;
+        bytes[3] = value;
+    }
+
+    /**
+     * @brief NTP 32.32 timestamp to Unix microseconds, era 1 starts in 2036
+     */
+    int64_t timestampToUs(const uint8_t* bytes) {
+        const uint32_t Seconds = readU32(bytes);
+        const uint32_t Fraction = readU32(bytes + 4);
+        const int64_t Era = (Seconds & 0x80000000u) ? 0 : (int64_t{1} << 32);
+        const int64_t UnixSeconds = Era + Seconds - static_cast<int64_t>(NTP_UNIX_EPOCH_OFFSET);
+        return UnixSeconds * 1'000'000 + ((static_cast<uint64_t>(Fraction) * 1'000'000) >> 32);
+    }
+
+    void usToTimestamp(int64_t unixUs, uint8_t* bytes) {
+        const int64_t Seconds = unixUs / 1'000'000;
+        const int64_t Micros = unixUs % 1'000'000;
+        writeU32(bytes, static_cast<uint32_t>(Seconds + NTP_UNIX_EPOCH_OFFSET));
+        writeU32(bytes + 4, static_cast<uint32_t>((static_cast<uint64_t>(Micros) << 32) / 1'000'000));
+    }
+
+    /**
+     * @brief NTP 16.16 short format to microseconds
+     */
+    int64_t shortToUs(const uint8_t* bytes) {
+        return (static_cast<int64_t>(readU32(bytes)) * 1'000'000) >> 16;
+    }
+
+    int openRequest(const ntp::server_t& server, uint8_t* transmit) {
+        addrinfo hints {};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+
+        char port[8];
+        snprintf(port, sizeof(port), "%u", server.port);
+
+        addrinfo* address = nullptr;
+        if (getaddrinfo(server.host, port, &hints, &address) != 0 || address == nullptr) {
+            ESP_LOGW(TAG, "poll: unable to resolve %s", server.host);
+            return -1;
+        }
+
+        /* Connected socket only receives datagrams from the server*/
+        const int Sock = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (Sock < 0 || connect(Sock, address->ai_addr, address->ai_addrlen) != 0) {
+            ESP_LOGW(TAG, "poll: unable to open socket to %s", server.host);
+            if (Sock >= 0) {
+                close(Sock);
+            }
+            freeaddrinfo(address);
+            return -1;
+        }
+        freeaddrinfo(address);
+
+        uint8_t packet[NTP_PACKET_SIZE] = {};
+        packet[0] = (NTP_VERSION << 3) | NTP_MODE_CLIENT;
+        usToTimestamp(wallTimeUs(), transmit);
+        memcpy(packet + 40, transmit, 8);
+
+        if (send(Sock, packet, sizeof(packet), 0) != sizeof(packet)) {
+            ESP_LOGW(TAG, "poll: unable to send request to %s", server.host);
+            close(Sock);
+            return -1;
+        }
+        return Sock;
+    }
+
+    /**
+     * @brief Answer is for our request, origin must echo our transmit timestamp
+     */
+    bool isOurAnswer(const uint8_t* packet, const uint8_t* transmit) {
+        return memcmp(packet + 24, transmit, 8) == 0;
+    }
+
+    /**
+     * @brief Validate answer to our request and turn it into a sample
+     */
+    bool parseAnswer(const uint8_t* packet, const uint8_t* transmit, int64_t receivedUs, int64_t pendingSlewUs,
+                     ntp::sample_t& sample, uint8_t& stratum) {
+        const uint8_t Leap = packet[0] >> 6;
+        const uint8_t Mode = packet[0] & 0x07;
+        stratum = packet[1];
+        if (Leap == NTP_LI_UNSYNCHRONIZED || Mode != NTP_MODE_SERVER || stratum == 0 || stratum > NTP_MAX_STRATUM) {
+            return false;
+        }
+        if (readU32(packet + 40) == 0) {
+            return false;
+        }
+
+        const int64_t T1 = timestampToUs(transmit);
+        const int64_t T2 = timestampToUs(packet + 32);
+        const int64_t T3 = timestampToUs(packet + 40);
+        const int64_t T4 = receivedUs;
+
+        const int64_t MeasuredOffsetUs = ((T2 - T1) + (T3 - T4)) / 2;
+        sample.offsetUs = MeasuredOffsetUs - pendingSlewUs;
+        sample.delayUs = std::max<int64_t>((T4 - T1) - (T3 - T2), 0);
+        sample.distanceUs = sample.delayUs / 2 + shortToUs(packet + 4) / 2 + shortToUs(packet + 8);
+        sample.takenUs = esp_timer_get_time();
+        return true;
+    }
+}
+
+namespace ntp {
+
+    esp_err_t Client::setServers(const char* list) {
+        std::array<server_t, MaxServers> servers {};
+        std::size_t count = 0;
+
+        const char* cursor = list;
+        while (*cursor != '\0') {
+            while (*cursor == ' ' || *cursor == ',') {
+                cursor++;
+            }
+            const std::size_t Length = strcspn(cursor, ", ");
+            if (Length == 0) {
+                break;
+            }
+            if (count == MaxServers || Length >= HostLength) {
+                ESP_LOGE(TAG, "setServers: up to %zu servers of %zu chars supported: %s", MaxServers, HostLength - 1, list);
+                return ESP_ERR_INVALID_ARG;
+            }
+
+            server_t& server = servers[count++];
+            memcpy(server.host, cursor, Length);
+            server.port = DefaultPort;
+            char* colon = strchr(server.host, ':');
+            if (colon != nullptr) {
+                *colon = '\0';
+                server.port = static_cast<uint16_t>(atoi(colon + 1));
+            }
+            cursor += Length;
+        }
+
+        if (count == 0) {
+            ESP_LOGE(TAG, "setServers: empty server list");
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        servers_ = servers;
+        serverCount_ = count;
+        return ESP_OK;
+    }
+
+    esp_err_t Client::poll(uint32_t timeoutMs, int64_t pendingSlewUs, result_t& result) {
+        std::array<int, MaxServers> sockets;
+        std::array<std::array<uint8_t, 8>, MaxServers> transmits {};
+        sockets.fill(-1);
+
+        const int64_t DeadlineUs = esp_timer_get_time() + static_cast<int64_t>(timeoutMs) * 1000;
+        std::size_t waiting = 0;
+        for (std::size_t i = 0; i < serverCount_; i++) {
+            servers_[i].reach <<= 1;
+            sockets[i] = openRequest(servers_[i], transmits[i].data());
+            waiting += (sockets[i] >= 0);
+        }
+
+        result.answered = 0;
+        while (waiting > 0) {
+            const int64_t RemainingUs = DeadlineUs - esp_timer_get_time();
+            if (RemainingUs <= 0) {
+                break;
+            }
+
+            fd_set readable;
+            FD_ZERO(&readable);
+            int maxSocket = -1;
+            for (std::size_t i = 0; i < serverCount_; i++) {
+                if (sockets[i] >= 0) {
+                    FD_SET(sockets[i], &readable);
+                    maxSocket = std::max(maxSocket, sockets[i]);
+                }
+            }
+            timeval timeout = {
+                .tv_sec = static_cast<time_t>(RemainingUs / 1'000'000),
+                .tv_usec = static_cast<suseconds_t>(RemainingUs % 1'000'000),
+            };
+            if (::select(maxSocket + 1, &readable, nullptr, nullptr, &timeout) <= 0) {
+                break;
+            }
+
+            for (std::size_t i = 0; i < serverCount_; i++) {
+                if (sockets[i] < 0 || !FD_ISSET(sockets[i], &readable)) {
+                    continue;
+                }
+
+                uint8_t packet[NTP_PACKET_SIZE];
+                const int Received = recv(sockets[i], packet, sizeof(packet), 0);
+                const int64_t ReceivedUs = wallTimeUs();
+                server_t& server = servers_[i];
+                sample_t sample;
+                if (Received < NTP_PACKET_SIZE || !isOurAnswer(packet, transmits[i].data())) {
+                    /* Stale or forged, keep waiting, our answer may still come*/
+                    ESP_LOGW(TAG, "poll: dropped unexpected answer of %s:%u", server.host, server.port);
+                    continue;
+                }
+
+                if (parseAnswer(packet, transmits[i].data(), ReceivedUs, pendingSlewUs, sample, server.stratum)) {
+                    server.samples[server.next] = sample;
+                    server.next = (server.next + 1) % FilterSamples;
+                    server.count = std::min<std::size_t>(server.count + 1, FilterSamples);
+                    server.reach |= 1;
+                    result.answered++;
+                    ESP_LOGD(TAG, "poll: %s:%u stratum %u offset %" PRId64 " us delay %" PRId64 " us",
+                             server.host, server.port, server.stratum, sample.offsetUs, sample.delayUs);
+                } else {
+                    /* Unsynchronized or kiss-o'-death, server will not send another answer*/
+                    ESP_LOGW(TAG, "poll: %s:%u rejected the request", server.host, server.port);
+                }
+
+                close(sockets[i]);
+                sockets[i] = -1;
+                waiting--;
+            }
+        }
+
+        for (const int Sock : sockets) {
+            if (Sock >= 0) {
+                close(Sock);
+            }
+        }
+
+        if (result.answered == 0) {
+            return ESP_ERR_TIMEOUT;
+        }
+        return selectBest(result) ? ESP_OK : ESP_ERR_NOT_FOUND;
+    }
+
+    void Client::applyCorrection(int64_t correctionUs) {
+        for (std::size_t i = 0; i < serverCount_; i++) {
+            for (std::size_t j = 0; j < servers_[i].count; j++) {
+                servers_[i].samples[j].offsetUs -= correctionUs;
+            }
+        }
+    }
+
+    int64_t Client::agedDistanceUs(const sample_t& sample, int64_t nowUs) {
+        return sample.distanceUs + (nowUs - sample.takenUs) * NTP_PHI_PPM / 1'000'000;
+    }
+
+    const sample_t* Client::filter(const server_t& server, int64_t nowUs) {
+        if (server.count == 0 || server.reach == 0) {
+            return nullptr;
+        }
+        /* Dispersion grows with age, an old low delay sample gives way to fresh ones*/
+        const auto AgedDelayUs = [nowUs](const sample_t& sample) {
+            return sample.delayUs + 2 * (nowUs - sample.takenUs) * NTP_PHI_PPM / 1'000'000;
+        };
+        return &*std::min_element(server.samples.begin(), server.samples.begin() + server.count,
+                                  [&](const sample_t& a, const sample_t& b) { return AgedDelayUs(a) < AgedDelayUs(b); });
+    }
+
+    bool Client::selectBest(result_t& result) const {
+        std::array<const sample_t*, MaxServers> best {};
+        std::array<int64_t, MaxServers> offsets {};
+        std::size_t candidates = 0;
+        const int64_t NowUs = esp_timer_get_time();
+        for (std::size_t i = 0; i < serverCount_; i++) {
+            best[i] = filter(servers_[i], NowUs);
+            if (best[i] != nullptr) {
+                offsets[candidates++] = best[i]->offsetUs;
+            }
+        }
+        if (candidates == 0) {
+            return false;
+        }
+
+        /* With a majority available, servers far from the median offset are falsetickers*/
+        int64_t medianUs = 0;
+        const bool HaveMajority = candidates >= 3;
+        if (HaveMajority) {
+            std::nth_element(offsets.begin(), offsets.begin() + candidates / 2, offsets.begin() + candidates);
+            medianUs = offsets[candidates / 2];
+        }
+
+        bool found = false;
+        for (std::size_t i = 0; i < serverCount_; i++) {
+            if (best[i] == nullptr) {
+                continue;
+            }
+            const int64_t DistanceUs = agedDistanceUs(*best[i], NowUs);
+            if (HaveMajority && std::llabs(best[i]->offsetUs - medianUs) > DistanceUs + NTP_MAX_DISAGREEMENT_US) {
+                ESP_LOGW(TAG, "select: %s:%u disagrees with majority by %" PRId64 " us", servers_[i].host,
+                         servers_[i].port, best[i]->offsetUs - medianUs);
+                continue;
+            }
+            if (!found || DistanceUs < result.sample.distanceUs) {
+                result.server = i;
+                result.sample = *best[i];
+                result.sample.distanceUs = DistanceUs;
+                found = true;
+            }
+        }
+        return found;
+    }
+}
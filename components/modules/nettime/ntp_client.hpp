@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "esp_err.h"
+
+namespace ntp {
+    constexpr uint16_t DefaultPort = 123;
+    constexpr std::size_t MaxServers = 4;
+    constexpr std::size_t FilterSamples = 8;     ///< NTP clock filter depth
+    constexpr std::size_t HostLength = 64;
+
+    /**
+     * @brief Single exchange with a server
+     */
+    typedef struct {
+        int64_t offsetUs;      ///< Server clock minus local clock, pending slew excluded
+        int64_t delayUs;       ///< Round trip delay
+        int64_t distanceUs;    ///< Root distance: delay / 2 plus server root delay / 2 and dispersion
+        int64_t takenUs;       ///< esp_timer time of the exchange
+    } sample_t;
+
+    typedef struct {
+        char host[HostLength];
+        uint16_t port;
+        uint8_t stratum;
+        uint8_t reach;         ///< Answers of the last 8 polls, bit 0 is the latest
+        std::array<sample_t, FilterSamples> samples;
+        uint8_t count;
+        uint8_t next;
+    } server_t;
+
+    /**
+     * @brief Outcome of a poll
+     */
+    typedef struct {
+        std::size_t server;    ///< Index of the selected server
+        sample_t sample;       ///< Filtered sample of the selected server, distance includes its age
+        std::size_t answered;  ///< Servers which answered this poll
+    } result_t;
+
+    /**
+     * @brief SNTP client querying several servers in parallel
+     * @details Every poll sends one request to each server at once and waits for answers
+     * up to the timeout. Each server keeps its last FilterSamples exchanges and the one
+     * with the smallest delay represents it (NTP clock filter), dispersion of 15 ppm of its
+     * age is added so old samples give way to fresh ones. Servers which disagree with
+     * the majority are dropped, the one with the smallest root distance is selected.
+     */
+    class Client {
+    public:
+        /**
+         * @brief Set servers from "host[:port],host[:port],..." list, up to MaxServers
+         * @note Drops collected samples
+         */
+        esp_err_t setServers(const char* list);
+
+        /**
+         * @brief Query all servers and select the best one
+         * @param pendingSlewUs Part of the last correction not applied by adjtime yet
+         * @retval ESP_ERR_TIMEOUT if no server answered
+         */
+        esp_err_t poll(uint32_t timeoutMs, int64_t pendingSlewUs, result_t& result);
+
+        /**
+         * @brief Local clock was corrected, shift stored offsets accordingly
+         */
+        void applyCorrection(int64_t correctionUs);
+
+        std::size_t getServerCount(void) const {
+            return serverCount_;
+        }
+
+        const server_t& getServer(std::size_t index) const {
+            return servers_[index];
+        }
+
+    private:
+        static int64_t agedDistanceUs(const sample_t& sample, int64_t nowUs);
+        static const sample_t* filter(const server_t& server, int64_t nowUs);
+        bool selectBest(result_t& result) const;
+
+        std::array<server_t, MaxServers> servers_ {};
+        std::size_t serverCount_ = 0;
+    };
+}
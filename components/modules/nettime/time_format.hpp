@@ -0,0 +1,149 @@
+/**
+ * @brief Precompiled time format specs
+ *
+ * A spec is parsed from a strftime-like pattern at compile time, formatting then only
+ * writes digits into a caller buffer: no heap, no locale or TZ state, safe from any task.
+ * Supported fields: %Y %m %d %H %M %S and %%, other fields do not compile, other
+ * characters are copied as is.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "time.h"
+
+namespace time_format {
+
+    enum class Field : uint8_t {
+        LITERAL,
+        YEAR,
+        MONTH,
+        DAY,
+        HOUR,
+        MINUTE,
+        SECOND,
+    };
+
+    typedef struct {
+        Field field;
+        char literal; ///< Character of LITERAL token
+    } token_t;
+
+    /* Not constexpr: reaching it while compiling a spec makes the pattern a compile error*/
+    void unsupportedFormatField(void);
+
+    class Spec {
+    public:
+        static constexpr std::size_t MaxTokens = 24;
+
+        consteval Spec(const char* pattern) {
+            for (std::size_t i = 0; pattern[i] != '\0'; i++) {
+                if (count_ == MaxTokens) {
+                    unsupportedFormatField();
+                }
+                token_t& token = tokens_[count_++];
+                token.literal = pattern[i];
+                if (pattern[i] != '%') {
+                    token.field = Field::LITERAL;
+                    length_++;
+                    continue;
+                }
+
+                switch (pattern[++i]) {
+                    case 'Y': token.field = Field::YEAR; length_ += 4; break;
+                    case 'm': token.field = Field::MONTH; length_ += 2; break;
+                    case 'd': token.field = Field::DAY; length_ += 2; break;
+                    case 'H': token.field = Field::HOUR; length_ += 2; break;
+                    case 'M': token.field = Field::MINUTE; length_ += 2; break;
+                    case 'S': token.field = Field::SECOND; length_ += 2; break;
+                    case '%': token.field = Field::LITERAL; length_ += 1; break;
+                    default: unsupportedFormatField(); break;
+                }
+            }
+        }
+
+        /**
+         * @brief Formatted length without terminating zero, it does not depend on time
+         */
+        constexpr std::size_t getLength(void) const {
+            return length_;
+        }
+
+        /**
+         * @brief Write formatted time and terminating zero
+         * @return Formatted length, 0 if buffer is too small
+         */
+        std::size_t format(const tm& time, char* buf, std::size_t size) const {
+            if (size <= length_) {
+                return 0;
+            }
+
+            char* out = buf;
+            for (std::size_t i = 0; i < count_; i++) {
+                switch (tokens_[i].field) {
+                    case Field::LITERAL: *out++ = tokens_[i].literal; break;
+                    case Field::YEAR: out = digits(out, time.tm_year + 1900, 4); break;
+                    case Field::MONTH: out = digits(out, time.tm_mon + 1, 2); break;
+                    case Field::DAY: out = digits(out, time.tm_mday, 2); break;
+                    case Field::HOUR: out = digits(out, time.tm_hour, 2); break;
+                    case Field::MINUTE: out = digits(out, time.tm_min, 2); break;
+                    case Field::SECOND: out = digits(out, time.tm_sec, 2); break;
+                }
+            }
+            *out = '\0';
+            return length_;
+        }
+
+    private:
+        static char* digits(char* out, int value, std::size_t width) {
+            unsigned number = (value < 0) ? 0 : static_cast<unsigned>(value);
+            for (std::size_t i = width; i > 0; i--) {
+                out[i - 1] = static_cast<char>('0' + number % 10);
+                number /= 10;
+            }
+            return out + width;
+        }
+
+        std::array<token_t, MaxTokens> tokens_ {};
+        std::size_t count_ = 0;
+        std::size_t length_ = 0;
+    };
+
+    /**
+     * @brief Fixed capacity formatted time, returned by value
+     */
+    class Text {
+    public:
+        static constexpr std::size_t Capacity = 32;
+
+        const char* c_str(void) const {
+            return data_.data();
+        }
+
+        std::size_t size(void) const {
+            return size_;
+        }
+
+        char* data(void) {
+            return data_.data();
+        }
+
+        void setSize(std::size_t size) {
+            size_ = size;
+            data_[size] = '\0';
+        }
+
+    private:
+        std::array<char, Capacity> data_ {};
+        std::size_t size_ = 0;
+    };
+
+    inline constexpr Spec HourMinute {"%H:%M"};
+    inline constexpr Spec HourMinuteSecond {"%H:%M:%S"};
+    inline constexpr Spec IsoDate {"%Y-%m-%d"};
+    inline constexpr Spec IsoDateTime {"%Y-%m-%d %H:%M:%S"};
+
+    static_assert(IsoDateTime.getLength() < Text::Capacity, "longest spec must fit text");
+}
@@ -0,0 +1,194 @@
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "unity.h"
+#include "color.hpp"
+
+/* Every SWAR kernel must match color::reference byte for byte, including the bytes around the span*/
+
+namespace {
+    constexpr std::size_t MaxPixels = 37;                   ///< Several whole words plus a tail for 3 and 4 byte pixels
+    constexpr std::size_t MaxOffset = 3;                    ///< Start offsets 0..3 cover aligned and all unaligned cases
+    constexpr std::size_t BufferSize = (MaxPixels + 2) * 4 + MaxOffset;
+    constexpr std::array<uint16_t, 7> Weights = {0, 1, 127, 128, 200, 255, 256};
+    constexpr std::array<uint8_t, 6> Boundaries = {0, 1, 127, 128, 254, 255};
+
+    typedef struct {
+        alignas(4) uint8_t bytes[BufferSize];
+    } buffer_t;
+
+    /**
+     * @brief Deterministic bytes, half of them boundary values
+     */
+    void randomize(buffer_t& buffer, uint32_t seed) {
+        uint32_t state = seed * 2654435761u + 1;
+        for (uint8_t& byte : buffer.bytes) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            byte = (state & 0x100) ? Boundaries[(state >> 9) % Boundaries.size()] : static_cast<uint8_t>(state);
+        }
+    }
+
+    template<typename Pixel>
+    Pixel* at(buffer_t& buffer, std::size_t offset) {
+        return reinterpret_cast<Pixel*>(buffer.bytes + offset);
+    }
+
+    void expectSame(const buffer_t& expected, const buffer_t& actual, const char* kernel,
+                    std::size_t offset, std::size_t count, unsigned weight = 0) {
+        char message[80];
+        snprintf(message, sizeof(message), "%s: offset %zu count %zu weight %u", kernel, offset, count, weight);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY_MESSAGE(expected.bytes, actual.bytes, BufferSize, message);
+    }
+
+    template<typename Pixel>
+    void checkFill(void) {
+        for (std::size_t offset = 0; offset <= MaxOffset; offset++) {
+            for (std::size_t count = 0; count <= MaxPixels; count++) {
+                for (const uint8_t Value : Boundaries) {
+                    buffer_t expected, actual;
+                    randomize(expected, count);
+                    actual = expected;
+                    const Pixel Color = Pixel::fromRGB(color::CRGB(Value, 255 - Value, Value / 2));
+
+                    color::reference::fill(at<Pixel>(expected, offset), count, Color);
+                    color::fill(at<Pixel>(actual, offset), count, Color);
+                    expectSame(expected, actual, "fill", offset, count, Value);
+                }
+            }
+        }
+    }
+
+    template<typename Pixel>
+    void checkScale(void) {
+        for (std::size_t offset = 0; offset <= MaxOffset; offset++) {
+            for (std::size_t count = 0; count <= MaxPixels; count++) {
+                for (const uint16_t Level : Weights) {
+                    buffer_t expected, actual;
+                    randomize(expected, count + Level);
+                    actual = expected;
+
+                    color::reference::scale(expected.bytes + offset, count * sizeof(Pixel), Level);
+                    color::scale(at<Pixel>(actual, offset), count, Level);
+                    expectSame(expected, actual, "scale", offset, count, Level);
+                }
+            }
+        }
+    }
+
+    template<typename Pixel>
+    void checkLerp(void) {
+        for (std::size_t offsetA = 0; offsetA <= MaxOffset; offsetA++) {
+            for (std::size_t offsetOut = 0; offsetOut <= MaxOffset; offsetOut++) {
+                for (std::size_t count = 0; count <= MaxPixels; count++) {
+                    for (const uint16_t Alpha : Weights) {
+                        buffer_t a, b, expected, actual;
+                        randomize(a, count);
+                        randomize(b, count + 1000);
+                        randomize(expected, count + 2000);
+                        actual = expected;
+
+                        /* b shares the start offset of out, a varies on its own*/
+                        color::reference::lerp(a.bytes + offsetA, b.bytes + offsetOut, expected.bytes + offsetOut,
+                                               count * sizeof(Pixel), Alpha);
+                        color::lerp(at<Pixel>(a, offsetA), at<Pixel>(b, offsetOut), at<Pixel>(actual, offsetOut),
+                                    count, Alpha);
+                        expectSame(expected, actual, "lerp", offsetA * 4 + offsetOut, count, Alpha);
+                    }
+                }
+            }
+        }
+    }
+
+    template<typename Pixel>
+    void checkAddSaturate(void) {
+        for (std::size_t offsetDst = 0; offsetDst <= MaxOffset; offsetDst++) {
+            for (std::size_t offsetSrc = 0; offsetSrc <= MaxOffset; offsetSrc++) {
+                for (std::size_t count = 0; count <= MaxPixels; count++) {
+                    buffer_t src, expected, actual;
+                    randomize(src, count);
+                    randomize(expected, count + 1000);
+                    actual = expected;
+
+                    color::reference::addSaturate(expected.bytes + offsetDst, src.bytes + offsetSrc, count * sizeof(Pixel));
+                    color::addSaturate(at<Pixel>(actual, offsetDst), at<Pixel>(src, offsetSrc), count);
+                    expectSame(expected, actual, "addSaturate", offsetDst * 4 + offsetSrc, count);
+                }
+            }
+        }
+    }
+
+    template<typename Pixel>
+    void checkConvert(void) {
+        for (std::size_t offsetSrc = 0; offsetSrc <= MaxOffset; offsetSrc++) {
+            for (std::size_t offsetDst = 0; offsetDst <= MaxOffset; offsetDst++) {
+                for (std::size_t count = 0; count <= MaxPixels; count++) {
+                    buffer_t src, expected, actual;
+                    randomize(src, count);
+                    randomize(expected, count + 1000);
+                    actual = expected;
+
+                    color::reference::convert(at<color::CRGB>(src, offsetSrc), at<Pixel>(expected, offsetDst), count);
+                    color::convert(at<color::CRGB>(src, offsetSrc), at<Pixel>(actual, offsetDst), count);
+                    expectSame(expected, actual, "convert", offsetSrc * 4 + offsetDst, count);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("fill matches reference", "[color]") {
+    checkFill<color::CGRB>();
+    checkFill<color::CRGBOrder>();
+    checkFill<color::CGRBW>();
+}
+
+TEST_CASE("scale matches reference", "[color]") {
+    checkScale<color::CGRB>();
+    checkScale<color::CGRBW>();
+}
+
+TEST_CASE("lerp matches reference", "[color]") {
+    checkLerp<color::CGRB>();
+    checkLerp<color::CGRBW>();
+}
+
+TEST_CASE("addSaturate matches reference", "[color]") {
+    checkAddSaturate<color::CGRB>();
+    checkAddSaturate<color::CGRBW>();
+}
+
+TEST_CASE("convert matches reference", "[color]") {
+    checkConvert<color::CGRB>();
+    checkConvert<color::CRGBOrder>();
+    checkConvert<color::CGRBW>();
+}
+
+TEST_CASE("swapRG converts in place", "[color]") {
+    for (std::size_t offset = 0; offset <= MaxOffset; offset++) {
+        for (std::size_t count = 0; count <= MaxPixels; count++) {
+            buffer_t expected, actual;
+            randomize(expected, count);
+            actual = expected;
+
+            color::reference::convert(at<color::CRGB>(expected, offset), at<color::CGRB>(expected, offset), count);
+            color::convert(at<color::CRGB>(actual, offset), at<color::CGRB>(actual, offset), count);
+            expectSame(expected, actual, "convert in place", offset, count);
+        }
+    }
+}
+
+TEST_CASE("lerp weight boundaries select an input", "[color]") {
+    buffer_t a, b, out;
+    randomize(a, 1);
+    randomize(b, 2);
+    const std::size_t Count = MaxPixels;
+
+    color::lerp(at<color::CGRB>(a, 0), at<color::CGRB>(b, 0), at<color::CGRB>(out, 0), Count, 0);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(a.bytes, out.bytes, Count * sizeof(color::CGRB));
+    color::lerp(at<color::CGRB>(a, 0), at<color::CGRB>(b, 0), at<color::CGRB>(out, 0), Count, 256);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(b.bytes, out.bytes, Count * sizeof(color::CGRB));
+}
@@ -0,0 +1,9 @@
+#include <cstdlib>
+
+#include "unity.h"
+
+extern "C" void app_main(void) {
+    UNITY_BEGIN();
+    unity_run_all_tests();
+    std::exit(UNITY_END());
+}
@@ -0,0 +1,189 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <array>
+#include <cinttypes>
+#include <cstring>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_console.h"
+#endif
+
+#if CONFIG_TRACE_ENABLE
+
+#define TRACE_ISR_TID   (0) //< all interrupts of a core share one timeline
+
+namespace {
+    constexpr uint32_t BufferEvents = CONFIG_TRACE_BUFFER_EVENTS;
+    static_assert(BufferEvents && (BufferEvents & (BufferEvents - 1)) == 0, "trace buffer size must be a power of two");
+
+    /**
+     * @brief Ring buffer slot, sequence is 0 while the slot is being written
+     */
+    typedef struct {
+        std::atomic<uint32_t> sequence; ///< Index of the event + 1
+        uint32_t timestampUs;           ///< Lower 32 bits of esp_timer time, dump is relative
+        const char *name;
+        uint32_t tid;
+        int32_t value;
+        uint8_t core;
+        trace::Phase phase;
+    } event_t;
+
+    std::array<event_t, BufferEvents> events;
+    std::atomic<uint32_t> head {0};     ///< Index of the next event
+    std::atomic<uint32_t> tail {0};     ///< Index of the oldest event not cleared
+    std::atomic<bool> paused {false};
+
+    bool inIsr(void) {
+#if CONFIG_IDF_TARGET_LINUX
+        return false;
+#else
+        return xPortInIsrContext();
+#endif
+    }
+
+    uint8_t coreId(void) {
+#if CONFIG_IDF_TARGET_LINUX
+        return 0;
+#else
+        return xPortGetCoreID();
+#endif
+    }
+
+    /**
+     * @brief Copy event out of the ring, fails if it was overwritten meanwhile
+     */
+    bool readEvent(uint32_t index, event_t& out) {
+        const event_t& Slot = events[index & (BufferEvents - 1)];
+        if (Slot.sequence.load(std::memory_order_acquire) != index + 1) {
+            return false;
+        }
+        out.timestampUs = Slot.timestampUs;
+        out.name = Slot.name;
+        out.tid = Slot.tid;
+        out.value = Slot.value;
+        out.core = Slot.core;
+        out.phase = Slot.phase;
+        return Slot.sequence.load(std::memory_order_acquire) == index + 1;
+    }
+
+#if !CONFIG_IDF_TARGET_LINUX
+    int traceCommand(int argc, char **argv) {
+        if (argc > 1 && strcmp(argv[1], "clear") == 0) {
+            trace::clear();
+            return 0;
+        }
+        return (trace::dump(stdout) == ESP_OK) ? 0 : 1;
+    }
+#endif
+}
+
+void trace::record(Phase phase, const char *name, int32_t value) {
+    if (paused.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    const uint32_t Index = head.fetch_add(1, std::memory_order_relaxed);
+    event_t& slot = events[Index & (BufferEvents - 1)];
+
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.timestampUs = static_cast<uint32_t>(esp_timer_get_time());
+    slot.name = name;
+    slot.tid = inIsr() ? TRACE_ISR_TID : reinterpret_cast<uintptr_t>(xTaskGetCurrentTaskHandle());
+    slot.value = value;
+    slot.core = coreId();
+    slot.phase = phase;
+    slot.sequence.store(Index + 1, std::memory_order_release);
+}
+
+void trace::clear(void) {
+    tail.store(head.load());
+}
+
+esp_err_t trace::dump(FILE *out) {
+    paused.store(true);
+
+    const uint32_t Head = head.load();
+    const uint32_t Tail = tail.load();
+    const uint32_t Count = std::min(Head - Tail, BufferEvents);
+    const uint32_t First = Head - Count;
+
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"core 0\"}},\n");
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"core 1\"}}");
+
+    bool haveOrigin = false;
+    uint32_t originUs = 0;
+    uint32_t skipped = 0;
+    for (uint32_t index = First; index != Head; index++) {
+        event_t event;
+        if (!readEvent(index, event)) {
+            skipped++;
+            continue;
+        }
+        if (!haveOrigin) {
+            originUs = event.timestampUs;
+            haveOrigin = true;
+        }
+
+        /* 32-bit difference stays correct across wrap of the timestamp*/
+        fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%" PRIu32 ",\"pid\":%u,\"tid\":%" PRIu32,
+                event.name, static_cast<char>(event.phase), event.timestampUs - originUs,
+                static_cast<unsigned>(event.core), event.tid);
+        if (event.phase == Phase::INSTANT) {
+            fprintf(out, ",\"s\":\"t\"");
+        } else if (event.phase == Phase::COUNTER) {
+            fprintf(out, ",\"args\":{\"value\":%" PRId32 "}", event.value);
+        }
+        fprintf(out, "}");
+    }
+    /* Log output shares the console, so dump statistics go into the JSON itself*/
+    fprintf(out, "\n],\"otherData\":{\"events\":%" PRIu32 ",\"lost\":%" PRIu32 ",\"overwritten\":%" PRIu32 "}}\n",
+            Count - skipped, skipped, (Head - Tail) - Count);
+    fflush(out);
+
+    paused.store(false);
+    return ESP_OK;
+}
+
+esp_err_t trace::registerCommand(void) {
+#if CONFIG_IDF_TARGET_LINUX
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    const esp_console_cmd_t Command = {
+        .command = "trace",
+        .help = "Print recorded trace events as Chrome trace JSON, 'trace clear' drops them",
+        .hint = "[clear]",
+        .func = &traceCommand,
+    };
+    return esp_console_cmd_register(&Command);
+#endif
+}
+
+#else
+
+static const char *TAG = "trace";
+
+void trace::record(Phase phase, const char *name, int32_t value) {
+}
+
+void trace::clear(void) {
+}
+
+esp_err_t trace::dump(FILE *out) {
+    ESP_LOGW(TAG, "dump: tracing is disabled (CONFIG_TRACE_ENABLE)");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t trace::registerCommand(void) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
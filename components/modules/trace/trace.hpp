@@ -0,0 +1,87 @@
+/**
+ * @brief Low overhead event tracing
+ *
+ * Timestamped begin/end/instant events go to a lock-free ring buffer, recording is
+ * safe from tasks on both cores and from ISRs. The oldest events are overwritten.
+ * The buffer is dumped as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+ *
+ * Tracing is enabled with CONFIG_TRACE_ENABLE, otherwise the macros below compile
+ * to nothing. Event names must be string literals, only the pointer is recorded.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+namespace trace {
+
+    enum class Phase : char {
+        BEGIN = 'B',
+        END = 'E',
+        INSTANT = 'i',
+        COUNTER = 'C',
+    };
+
+    /**
+     * @brief Record event, ISR safe
+     * @param phase Event kind
+     * @param name Static event name
+     * @param value Counter value, ignored for other events
+     */
+    void record(Phase phase, const char *name, int32_t value = 0);
+
+    /**
+     * @brief Write recorded events as Chrome trace JSON
+     * @note Recording is paused while dumping
+     */
+    esp_err_t dump(FILE *out);
+
+    /**
+     * @brief Drop all recorded events
+     */
+    void clear(void);
+
+    /**
+     * @brief Register "trace [clear]" console command
+     * @note Console REPL must be created by the caller
+     */
+    esp_err_t registerCommand(void);
+
+    /**
+     * @brief Records begin event on construction and end event on destruction
+     */
+    class Scope {
+    public:
+        explicit Scope(const char *name) : name_(name) {
+            record(Phase::BEGIN, name_);
+        }
+        ~Scope() {
+            record(Phase::END, name_);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char *name_;
+    };
+}
+
+#if CONFIG_TRACE_ENABLE
+#define TRACE_CONCAT_(a, b)     a##b
+#define TRACE_CONCAT(a, b)      TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name)       trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_BEGIN(name)       trace::record(trace::Phase::BEGIN, name)
+#define TRACE_END(name)         trace::record(trace::Phase::END, name)
+#define TRACE_INSTANT(name)     trace::record(trace::Phase::INSTANT, name)
+#define TRACE_COUNTER(name, v)  trace::record(trace::Phase::COUNTER, name, v)
+#else
+#define TRACE_SCOPE(name)       do {} while (0)
+#define TRACE_BEGIN(name)       do {} while (0)
+#define TRACE_END(name)         do {} while (0)
+#define TRACE_INSTANT(name)     do {} while (0)
+#define TRACE_COUNTER(name, v)  do { (void)(v); } while (0)
+#endif
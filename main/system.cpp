@@ -3,11 +3,22 @@
 #include "itf_wifi.hpp"
 #include "application.hpp"
 #include "nettime.hpp"
+#include "led_bench.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include <cinttypes>
+#if !CONFIG_IDF_TARGET_LINUX
+#define SYSTEM_CONSOLE_ENABLE   1
+#include "esp_console.h"
+#endif
 
 static const char *TAG = "systemTask";
 
@@ -15,49 +26,141 @@ static const char *TAG = "systemTask";
 #define WIFI_PASSWORD   "Thunder_Bolt1"
 #define LOCAL_TIMEZONE  "MSK-3"
 
+#define NETWORK_TASK_STACK_SIZE     (4 * 1024)
+#define NETWORK_TASK_PRIORITY       (4)
+
 static void systemWifiFail_Callback(WifiFailEvents event);
+static void systemWifiState_Callback(WifiState state);
+static void systemTimeSync_Callback(bool success);
+static void systemNetworkTask(void *arg);
+#if SYSTEM_CONSOLE_ENABLE
+static esp_err_t systemConsoleInit(void);
+#endif
 
 const itf_wifi_config_t wifiConfig = {
     .ssid = WIFI_SSID,
     .password = WIFI_PASSWORD,
     .failCallBack = systemWifiFail_Callback,
+    .stateCallBack = systemWifiState_Callback,
 };
 
+/**
+ * @brief Run one boot phase, log how long it took and when it finished
+ */
+template <typename Phase>
+static esp_err_t systemBootPhase(const char *name, Phase phase) {
+    TRACE_SCOPE(name);
+    const int64_t StartUs = esp_timer_get_time();
+    const esp_err_t Ret = phase();
+    const int64_t EndUs = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "boot: %-12s took %5" PRId64 " ms, done at %6" PRId64 " ms%s", name,
+             (EndUs - StartUs) / 1000, EndUs / 1000, (Ret == ESP_OK) ? "" : " (failed)");
+    return Ret;
+}
+
 void systemTask(void *arg) {
-    /* Initialize flash for storing credentials*/
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
+    /* Initialize flash for storing credentials, timezone and clock drift*/
+    ESP_ERROR_CHECK(systemBootPhase("nvs", [] {
+        esp_err_t ret = nvs_flash_init();
+        if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+            ESP_ERROR_CHECK(nvs_flash_erase());
+            ret = nvs_flash_init();
+        }
+        return ret;
+    }));
+
+    /* Time kept by the RTC over a reset is shown right away, NTP waits for the network.
+       The face and network still start without the time service*/
+    if (systemBootPhase("time", [] { return NetTime::init(LOCAL_TIMEZONE); }) != ESP_OK) {
+        ESP_LOGE(TAG, "time service init failed, continuing without it");
+    }
+
+    /* Wi-Fi joins in the background while the face starts*/
+    if (xTaskCreate(systemNetworkTask, "networkTask", NETWORK_TASK_STACK_SIZE, nullptr, NETWORK_TASK_PRIORITY, nullptr) != pdPASS) {
+        ESP_LOGE(TAG, "network task creation failed (insufficient heap?)");
     }
-    ESP_ERROR_CHECK(ret);
 
     ILedMatrixDisplay *display = Board_getDisplay();
     if (display == nullptr) {
         ESP_ERROR_CHECK(ESP_FAIL);
     }
 
-    ESP_ERROR_CHECK(display->init({16, 16}));
+    ESP_ERROR_CHECK(systemBootPhase("display", [display] { return display->init({16, 16}); }));
 
-    ESP_ERROR_CHECK(Board_wifiInit());
+#if CONFIG_LED_BENCH_ENABLE && CONFIG_IDF_TARGET_LINUX
+    LedBench_run(nullptr, CONFIG_LED_BENCH_PIXEL_BUDGET);
+#endif
+#if SYSTEM_CONSOLE_ENABLE
+    ESP_ERROR_CHECK(systemConsoleInit());
+#endif
 
-    if (Board_wifiConnect(wifiConfig, pdMS_TO_TICKS(5000)) == ESP_OK) {
-        NetTime::init(LOCAL_TIMEZONE); //< trying to connect to NTP server
-    }
-
-    ESP_ERROR_CHECK(ApplicationInit());
+    ESP_ERROR_CHECK(systemBootPhase("application", ApplicationInit));
 
     /* Periodic system service*/
     while (1) {
-        if (NetTime::isInited() && NetTime::isSynced()) {
-            const auto timeStr = NetTime::getLocalTimeString("%Y-%m-%d %H:%M:%S");
-            ESP_LOGI(TAG, "%s", timeStr.c_str());
-        }
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_METRICS_SUMMARY_PERIOD_S * 1000));
 
-        vTaskDelay(pdMS_TO_TICKS(1000));
+        if (NetTime::isInited() && NetTime::isTimeValid()) {
+            ESP_LOGI(TAG, "%s", NetTime::getLocalTimeText(time_format::IsoDateTime).c_str());
+        }
+        metrics::logSummary();
     }
 }
 
 static void systemWifiFail_Callback(WifiFailEvents event) {
     return;
-}
\ No newline at end of file
+}
+
+static void systemWifiState_Callback(WifiState state) {
+    static bool isFirstConnection = true;
+    if (state != WifiState::CONNECTED) {
+        return;
+    }
+
+    if (isFirstConnection) {
+        isFirstConnection = false;
+        ESP_LOGI(TAG, "boot: wifi connected at %6" PRId64 " ms", esp_timer_get_time() / 1000);
+    }
+    /* Refresh time after every (re)connect, a sync already running covers it*/
+    if (NetTime::isInited()) {
+        NetTime::syncAsync(systemTimeSync_Callback);
+    }
+}
+
+static void systemTimeSync_Callback(bool success) {
+    static bool isFirstSync = true;
+    if (success && isFirstSync) {
+        isFirstSync = false;
+        ESP_LOGI(TAG, "boot: time synced at %6" PRId64 " ms", esp_timer_get_time() / 1000);
+    }
+}
+
+static void systemNetworkTask(void *arg) {
+    /* Connection manager joins and reconnects in the background, state comes through the callback*/
+    if (systemBootPhase("wifi_init", Board_wifiInit) == ESP_OK) {
+        systemBootPhase("wifi_start", [] { return Board_wifiStart(wifiConfig); });
+    }
+
+    vTaskDelete(nullptr);
+}
+
+#if SYSTEM_CONSOLE_ENABLE
+static esp_err_t systemConsoleInit(void) {
+    esp_console_repl_t *repl = nullptr;
+    esp_console_repl_config_t replConfig = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    replConfig.prompt = "text_clock>";
+
+    const esp_console_dev_uart_config_t uartConfig = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    ESP_RETURN_ON_ERROR(esp_console_new_repl_uart(&uartConfig, &replConfig, &repl), TAG, "console repl creation failed");
+#if CONFIG_LED_BENCH_ENABLE
+    ESP_RETURN_ON_ERROR(LedBench_registerCommand(), TAG, "bench command registration failed");
+#endif
+    ESP_RETURN_ON_ERROR(metrics::registerCommand(), TAG, "metrics command registration failed");
+#if CONFIG_TRACE_ENABLE
+    ESP_RETURN_ON_ERROR(trace::registerCommand(), TAG, "trace command registration failed");
+#endif
+
+    return esp_console_start_repl(repl);
+}
+#endif
\ No newline at end of file
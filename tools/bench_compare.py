@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+"""
+Compares two LED pipeline benchmark runs and reports regressions.
+
+Inputs are logs of the "bench" console command (or of the linux target run),
+lines that are not benchmark JSON objects are ignored.
+
+Usage: bench_compare.py <baseline.log> <current.log> [threshold_percent]
+Exit code is 1 when any case got slower than threshold (default 10%).
+"""
+
+import json
+import sys
+
+
+def load(path):
+    results = {}
+    with open(path, encoding='utf-8', errors='replace') as file:
+        for line in file:
+            start = line.find('{"bench"')
+            if start < 0:
+                continue
+            try:
+                entry = json.loads(line[start:])
+            except ValueError:
+                continue
+            results[(entry['target'], entry['bench'], entry['leds'])] = entry['ns_per_pixel']
+    return results
+
+
+def main():
+    if len(sys.argv) not in (3, 4):
+        print(__doc__, file=sys.stderr)
+        return 2
+    baseline = load(sys.argv[1])
+    current = load(sys.argv[2])
+    threshold = float(sys.argv[3]) if len(sys.argv) == 4 else 10.0
+
+    regressions = 0
+    print('%-8s %-16s %5s %10s %10s %8s' % ('target', 'bench', 'leds', 'base ns', 'now ns', 'change'))
+    for key in sorted(current):
+        if key not in baseline:
+            continue
+        base, now = baseline[key], current[key]
+        change = (now - base) * 100.0 / base if base else 0.0
+        mark = ''
+        if change > threshold:
+            mark = '  REGRESSION'
+            regressions += 1
+        print('%-8s %-16s %5d %10.2f %10.2f %+7.1f%%%s' % (key[0], key[1], key[2], base, now, change, mark))
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""
+Generates word clock language header from a plain-text language pack.
+
+Language pack sections:
+    [grid]    letter grid rows, '.' marks a cell without letter
+    [words]   <name> <row> <col> <letters>, letters are checked against the grid
+    [hours]   <hour 1..12> = <words naming the hour>
+    [phrases] <minutes 0..55, step 5> = <words>, {H} and {H+1} expand to hour words
+    [dots]    words lit one by one for each minute past the 5 minute step
+
+Usage: gen_word_clock.py <language.txt> <output.hpp>
+"""
+
+import os
+import sys
+
+HOURS = range(1, 13)
+MINUTE_STEPS = range(0, 60, 5)
+NO_WORD = 0xFF
+
+
+class PackError(Exception):
+    pass
+
+
+def parse_sections(path):
+    sections = {}
+    current = None
+    with open(path, encoding='utf-8') as file:
+        for number, raw in enumerate(file, 1):
+            line = raw.split('#', 1)[0].strip()
+            if not line:
+                continue
+            if line.startswith('[') and line.endswith(']'):
+                current = line[1:-1]
+                sections[current] = []
+                continue
+            if current is None:
+                raise PackError(f'{path}:{number}: text outside of section')
+            sections[current].append((number, line))
+
+    for name in ('grid', 'words', 'hours', 'phrases'):
+        if name not in sections:
+            raise PackError(f'{path}: missing [{name}] section')
+    return sections
+
+
+def parse_grid(path, lines):
+    grid = [line for _, line in lines]
+    width = len(grid[0])
+    for number, line in lines:
+        if len(line) != width:
+            raise PackError(f'{path}:{number}: grid row is {len(line)} letters, expected {width}')
+    return grid
+
+
+def parse_words(path, lines, grid):
+    words = {}
+    for number, line in lines:
+        fields = line.split()
+        if len(fields) != 4:
+            raise PackError(f'{path}:{number}: expected "<name> <row> <col> <letters>"')
+        name, row, col, letters = fields[0], int(fields[1]), int(fields[2]), fields[3]
+        if name in words:
+            raise PackError(f'{path}:{number}: word {name} defined twice')
+        if row >= len(grid) or col + len(letters) > len(grid[row]):
+            raise PackError(f'{path}:{number}: word {name} does not fit the grid')
+        if grid[row][col:col + len(letters)] != letters:
+            raise PackError(f'{path}:{number}: word {name} is "{grid[row][col:col + len(letters)]}" in the grid, '
+                            f'expected "{letters}"')
+        words[name] = (len(words), row, col, letters)
+    if len(words) >= NO_WORD:
+        raise PackError(f'{path}: too many words')
+    return words
+
+
+def parse_rules(path, lines, words, keys, placeholders=()):
+    rules = {}
+    for number, line in lines:
+        key, _, value = line.partition('=')
+        key = int(key)
+        if key not in keys:
+            raise PackError(f'{path}:{number}: unexpected rule key {key}')
+        for token in value.split():
+            if token not in words and token not in placeholders:
+                raise PackError(f'{path}:{number}: unknown word {token}')
+        rules[key] = value.split()
+    missing = [key for key in keys if key not in rules]
+    if missing:
+        raise PackError(f'{path}: no rules for {missing}')
+    return rules
+
+
+def build_phrases(hours, phrases, words):
+    table = []
+    for hour in HOURS:
+        for minutes in MINUTE_STEPS:
+            ids = []
+            for token in phrases[minutes]:
+                if token == '{H}':
+                    ids += [words[name][0] for name in hours[hour]]
+                elif token == '{H+1}':
+                    ids += [words[name][0] for name in hours[hour % 12 + 1]]
+                else:
+                    ids.append(words[token][0])
+            table.append((hour, minutes, ids))
+    # Table is indexed by tm_hour % 12, so twelve o'clock goes first
+    return table[-12:] + table[:-12]
+
+
+def generate(path, output):
+    sections = parse_sections(path)
+    grid = parse_grid(path, sections['grid'])
+    words = parse_words(path, sections['words'], grid)
+    hours = parse_rules(path, sections['hours'], words, HOURS)
+    phrases = parse_rules(path, sections['phrases'], words, MINUTE_STEPS, ('{H}', '{H+1}'))
+    dots = [token for _, line in sections.get('dots', []) for token in line.split()]
+    for token in dots:
+        if token not in words:
+            raise PackError(f'{path}: unknown dot word {token}')
+
+    table = build_phrases(hours, phrases, words)
+    phrase_length = max(len(ids) for _, _, ids in table)
+    name = os.path.splitext(os.path.basename(path))[0]
+
+    out = []
+    out.append('/* Generated by gen_word_clock.py from %s, do not edit */' % os.path.basename(path))
+    out.append('')
+    out.append('#pragma once')
+    out.append('')
+    out.append('#include <array>')
+    out.append('#include <cstddef>')
+    out.append('#include <cstdint>')
+    out.append('')
+    out.append('#include "word_clock.hpp"')
+    out.append('')
+    out.append('namespace wordclock::lang {')
+    out.append('')
+    out.append('    constexpr const char *Name = "%s";' % name)
+    out.append('')
+    out.append('    static_assert(GridWidth == %d && GridHeight == %d, "language grid does not match the display");'
+               % (len(grid[0]), len(grid)))
+    out.append('')
+    out.append('    /* Letters of the face, UTF-8, one string per row*/')
+    out.append('    constexpr std::array<const char *, GridHeight> Grid = {{')
+    for row in grid:
+        out.append('        "%s",' % row)
+    out.append('    }};')
+    out.append('')
+    out.append('    constexpr std::array<Mask, %d> WordMasks = {{' % len(words))
+    for word, (index, row, col, letters) in words.items():
+        out.append('        Mask::span(%d, %d, %d), // %d %s %s' % (row, col, len(letters), index, word, letters))
+    out.append('    }};')
+    out.append('')
+    out.append('    constexpr uint8_t NoWord = 0x%02X;' % NO_WORD)
+    out.append('    constexpr std::size_t PhraseLength = %d;' % phrase_length)
+    out.append('    using Phrase = std::array<uint8_t, PhraseLength>;')
+    out.append('')
+    out.append('    /* Word ids lit for (tm_hour % 12) * 12 + tm_min / 5*/')
+    out.append('    constexpr std::array<Phrase, %d> Phrases = {{' % len(table))
+    for hour, minutes, ids in table:
+        padded = ids + [NO_WORD] * (phrase_length - len(ids))
+        out.append('        {%s}, // %02d:%02d' % (', '.join('0x%02X' % i for i in padded), hour, minutes))
+    out.append('    }};')
+    out.append('')
+    out.append('    constexpr std::array<uint8_t, %d> Dots = {%s};' % (len(dots), ', '.join(str(words[d][0]) for d in dots)))
+    out.append('}')
+    out.append('')
+
+    text = '\n'.join(out)
+    # Keep timestamp untouched when nothing changed to avoid needless rebuilds
+    if os.path.exists(output):
+        with open(output, encoding='utf-8') as file:
+            if file.read() == text:
+                return
+    with open(output, 'w', encoding='utf-8') as file:
+        file.write(text)
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__, file=sys.stderr)
+        return 2
+    try:
+        generate(sys.argv[1], sys.argv[2])
+    except (PackError, ValueError, OSError) as error:
+        print('gen_word_clock: error: %s' % error, file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
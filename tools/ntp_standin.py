@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""
+Local NTP stand-in for testing the NetTime client on the linux target.
+
+Every --server option opens one UDP NTP server on 127.0.0.1 which answers with
+host time shifted by the offset. Path delay is simulated by holding the request
+and the answer for half of the delay each, stratum 0 makes the server answer
+with a kiss-o'-death packet the client must ignore.
+
+Usage: ntp_standin.py --server PORT[:OFFSET_MS[:DELAY_MS[:STRATUM]]] [--server ...]
+
+Example, two good servers and a falseticker 2 s off:
+    ntp_standin.py --server 12300:250:20 --server 12301:260:40 --server 12302:2000:5
+and build the linux target with
+    CONFIG_NETTIME_SERVERS="127.0.0.1:12300,127.0.0.1:12301,127.0.0.1:12302"
+"""
+
+import argparse
+import socket
+import struct
+import threading
+import time
+
+NTP_UNIX_EPOCH_OFFSET = 2208988800
+PACKET = struct.Struct('!BBbbII4sQQQQ')
+
+
+def to_ntp(unix_time):
+    seconds = int(unix_time)
+    fraction = int((unix_time - seconds) * (1 << 32))
+    return ((seconds + NTP_UNIX_EPOCH_OFFSET) & 0xFFFFFFFF) << 32 | fraction
+
+
+def parse_server(text):
+    fields = text.split(':')
+    port = int(fields[0])
+    offset_ms = float(fields[1]) if len(fields) > 1 else 0.0
+    delay_ms = float(fields[2]) if len(fields) > 2 else 0.0
+    stratum = int(fields[3]) if len(fields) > 3 else 2
+    return port, offset_ms, delay_ms, stratum
+
+
+def answer(sock, request, address, offset_ms, delay_ms, stratum):
+    time.sleep(delay_ms / 2000.0)
+    received = time.time() + offset_ms / 1000.0
+    client_transmit = request[40:48]
+
+    leap_version_mode = (0 << 6) | (4 << 3) | 4
+    reference_id = b'LOCL' if stratum else b'RATE'
+    transmit = time.time() + offset_ms / 1000.0
+    packet = PACKET.pack(leap_version_mode, stratum, 6, -20,
+                         0x00000100, 0x00000100, reference_id,
+                         to_ntp(transmit - 16), struct.unpack('!Q', client_transmit)[0],
+                         to_ntp(received), to_ntp(transmit))
+    time.sleep(delay_ms / 2000.0)
+    sock.sendto(packet, address)
+
+
+def serve(port, offset_ms, delay_ms, stratum):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(('127.0.0.1', port))
+    print(f'port {port}: offset {offset_ms} ms, delay {delay_ms} ms, stratum {stratum}', flush=True)
+    while True:
+        request, address = sock.recvfrom(512)
+        if len(request) < 48:
+            continue
+        print(f'port {port}: request from {address[0]}:{address[1]}', flush=True)
+        threading.Thread(target=answer, args=(sock, request, address, offset_ms, delay_ms, stratum),
+                         daemon=True).start()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Local NTP stand-in')
+    parser.add_argument('--server', action='append', required=True, type=parse_server,
+                        help='PORT[:OFFSET_MS[:DELAY_MS[:STRATUM]]]')
+    args = parser.parse_args()
+
+    threads = [threading.Thread(target=serve, args=server, daemon=True) for server in args.server]
+    for thread in threads:
+        thread.start()
+    try:
+        for thread in threads:
+            thread.join()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()